@@ -19,8 +19,20 @@
  * and the routines within it.
  */
 #include <avr/io.h>
+#include <avr/interrupt.h>
 
 #include "hardware.h"
+#include "timer.h"
+#include "synthos-support.h"
+
+/*
+ * XBee pin sleep (SM=1):
+ *   SLEEP_RQ (XBee pin 9) is driven by PB1 (pin 9), high - sleep;
+ *   ON/SLEEP (XBee pin 13) is read on PB0 (pin 8, PCINT0), high - awake.
+ */
+#ifdef XBEE_POWER
+volatile uint32_t radio_on_time;
+#endif
 
 /**
  * @brief Hardware initialization routine
@@ -32,6 +44,17 @@ static void hardware_init (void) {
 
     /* Buzzer pin is set to output */
     DDRB |= _BV (DDB3);
+
+#ifdef XBEE_POWER
+    /* SLEEP_RQ is set to output, the radio is awake */
+    PORTB &= ~_BV (PORTB1);
+    DDRB |= _BV (DDB1);
+
+    /* ON/SLEEP is set to input, a change is timed */
+    DDRB &= ~_BV (DDB0);
+    PCMSK0 |= _BV (PCINT0);
+    PCICR |= _BV (PCIE0);
+#endif
 }
 
 /** @brief Enables led (pin 13)  */
@@ -59,3 +82,43 @@ void power_down (void) {
     SMCR = _BV (SM1) | _BV (SE);
     __asm__ __volatile__ ("sleep" ::: "memory");
 }
+
+/**
+ * @brief  Stops the CPU until the next interrupt (idle mode)
+ *
+ * The UART and TIMER2 keep running in idle mode and wake the CPU up.
+ * Interrupts have to be disabled on the call, so that the condition for
+ * sleeping can be checked without a race; they are enabled on return.
+ */
+void cpu_idle (void) {
+    SMCR = _BV (SE);
+    /* The instruction after sei is executed before any interrupt */
+    __asm__ __volatile__ ("sei\n\tsleep" ::: "memory");
+    SMCR = 0;
+}
+
+#ifdef XBEE_POWER
+ISR (PCINT0_vect) {
+    interrupt_count ++;
+    radio_on_time = lclock ();
+}
+
+/**
+ * @brief  Drives the radio SLEEP_RQ pin
+ * @param  sleep  nonzero - ask the radio to sleep, 0 - to wake up
+ */
+void radio_sleep_request (int sleep) {
+    if (sleep)
+        PORTB |= _BV (PORTB1);
+    else
+        PORTB &= ~_BV (PORTB1);
+}
+
+/**
+ * @brief  Reads the radio ON/SLEEP pin
+ * @return  nonzero if the radio is awake
+ */
+int radio_awake (void) {
+    return (PINB & _BV (PINB0)) != 0;
+}
+#endif
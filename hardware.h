@@ -18,8 +18,19 @@
  * intact in all distributions and all future versions of this file
  * and the routines within it.
  */
+#include <stdint.h>
+
 void led_enable (void);
 void led_disable (void);
 void buzzer_enable (void);
 void buzzer_disable (void);
 void power_down (void);
+void cpu_idle (void);
+
+#ifdef XBEE_POWER
+/** @brief lclock () at the last change of the radio ON/SLEEP pin */
+extern volatile uint32_t radio_on_time;
+
+void radio_sleep_request (int sleep);
+int radio_awake (void);
+#endif
@@ -0,0 +1,40 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         EEPROM access for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * The subset of <avr/eeprom.h> the driver uses. EEPROM variables are
+ * plain memory: they start erased (0) and last until the program exits.
+ */
+#ifndef HOST_AVR_EEPROM_H
+#define HOST_AVR_EEPROM_H
+
+#include <string.h>
+
+#define EEMEM
+
+static inline void eeprom_read_block (void * dst, const void * src, size_t n) {
+    memcpy (dst, src, n);
+}
+
+static inline void eeprom_update_block (const void * src, void * dst, size_t n) {
+    memcpy (dst, src, n);
+}
+
+#endif
@@ -0,0 +1,397 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Driver benchmark against the emulated mesh
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Usage: xbee-bench [-m tx|rx] [-n peers] [-c count] [-s size]
+ *                   [-d delay_us] [-l loss] [-r retries] [-b baudrate]
+ *                   [-i interval_us] [-a] [-w file]
+ *
+ * The driver runs radio 0 on node 0 of the mesh (see xbee-emu.h);
+ * the other nodes are virtual peers.
+ *   tx - the driver sends "count" frames to the peers in turn, keeping
+ *        XBEE_MAX_PENDING in flight; latency is from xbee_post to the
+ *        status (0x8B);
+ *   rx - the peers send "count" frames to the driver, one every
+ *        "interval_us" (0 - all at once); latency is from the peer to
+ *        the task that gets the data, frames that never get there are
+ *        counted as lost.
+ * -a makes tx use xbee_submit (see xbee-async.h), keeping XBEE_ASYNC_SLOTS
+ * in flight; latency is then from xbee_submit to the completion taken.
+ * -w writes the UART capture to the file, in the format of
+ * uart_capture_dump, for xbee-replay (built with UART_CAPTURE only).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "timer.h"
+#include "uart.h"
+#include "synthos-support.h"
+#include "xbee.h"
+#include "xbee-async.h"
+#include "host.h"
+#include "xbee-emu.h"
+
+/* Time limit for a response or a frame, in clock ticks */
+#define BENCH_TICKS 200
+
+static int bench_tx = 1, bench_async, bench_peers = 4, bench_count = 2000;
+static unsigned bench_size = 32, bench_interval;
+static xbee_emu_config_type bench_cfg = { 0, 0, 2000, 0, 3, 1, NULL };
+
+static uint32_t * bench_latency; /* microseconds */
+static int bench_done, bench_ok, bench_failed, bench_timeouts;
+static uint64_t bench_bytes, bench_start, bench_end;
+
+static xbee_request_type bench_reqs [XBEE_MAX_PENDING];
+static uint64_t bench_sent [XBEE_MAX_PENDING];
+static unsigned char bench_data [XBEE_MAX_PENDING][XBEE_MAX_PAYLOAD];
+
+/* Submit times, by handle */
+static uint64_t bench_submitted [256];
+
+static unsigned char bench_buf [XBEE_MAX_PAYLOAD];
+static xbee_receive_type bench_recv;
+
+#ifdef UART_CAPTURE
+static const char * bench_capture_name;
+static FILE * bench_capture_file;
+static unsigned char bench_capture_seen;
+
+/* Writes out the entries taken so far, as uart_capture_dump sends them */
+static void bench_capture_write (void) {
+    uart_capture_type entry;
+    unsigned char rec [4];
+
+    while (uart_capture_get (&entry)) {
+        rec [0] = (unsigned char) (entry.time >> 8);
+        rec [1] = (unsigned char) entry.time;
+        rec [2] = entry.flags;
+        rec [3] = entry.byte;
+        fwrite (rec, sizeof rec, 1, bench_capture_file);
+    }
+}
+
+/* This is a loop task: keeps the capture ring drained */
+static void bench_capture (void) {
+    /* Only the interrupts add entries */
+    SynthOS_wait (interrupt_count != bench_capture_seen);
+    bench_capture_seen = interrupt_count;
+    bench_capture_write ();
+}
+#endif
+
+/* Payload: send time (ns), then filler */
+static void bench_fill (unsigned char * p, unsigned size, int seq) {
+    uint64_t t = host_time_ns ();
+    unsigned i;
+
+    for (i = 0; i < size; i ++)
+        p [i] = (unsigned char) (seq + i);
+    memcpy (p, &t, size < sizeof t ? size : sizeof t);
+}
+
+static int bench_wait_associated (void) {
+    timer_type timeout;
+
+    timer_arm (&timeout, BENCH_TICKS);
+    SynthOS_wait ((associated & 1) || timeout.fired);
+    timer_cancel (&timeout);
+    return associated & 1;
+}
+
+static void bench_transmit (void) {
+    xbee_request_type * req;
+    timer_type timeout;
+    int sent, slot;
+
+    for (sent = 0; bench_done < bench_count; ) {
+        if (sent < bench_count && sent - bench_done < XBEE_MAX_PENDING) {
+            slot = sent % XBEE_MAX_PENDING;
+            req = &bench_reqs [slot];
+            req->req = xbee_request_transmit;
+            req->radio = 0;
+            req->args.transmit.addr_hi = XBEE_EMU_SH;
+            req->args.transmit.addr_lo = XBEE_EMU_SL + 1 + sent % bench_peers;
+            req->args.transmit.addr = xbee_addr_unknown;
+            req->args.transmit.data_ptr = bench_data [slot];
+            req->args.transmit.data_size = bench_size;
+            bench_fill (bench_data [slot], bench_size, sent);
+            bench_sent [slot] = host_time_ns ();
+            SynthOS_call (xbee_post (req));
+            sent ++;
+            continue;
+        }
+
+        slot = bench_done % XBEE_MAX_PENDING;
+        req = &bench_reqs [slot];
+        timer_arm (&timeout, BENCH_TICKS);
+        SynthOS_wait (!req->busy || timeout.fired);
+        timer_cancel (&timeout);
+        if (req->busy) {
+            xbee_cancel (req);
+            bench_timeouts ++;
+        } else if (req->args.transmit.status == 0) {
+            bench_latency [bench_ok ++] = (uint32_t) ((host_time_ns () - bench_sent [slot]) / 1000);
+            bench_bytes += bench_size;
+        } else
+            bench_failed ++;
+        bench_done ++;
+    }
+}
+
+static void bench_complete (const xbee_completion_type * c) {
+    if (c->status == 0) {
+        bench_latency [bench_ok ++] = (uint32_t) ((host_time_ns () - bench_submitted [c->handle]) / 1000);
+        bench_bytes += bench_size;
+    } else if (c->status == xbee_status_timeout)
+        bench_timeouts ++;
+    else
+        bench_failed ++;
+    bench_done ++;
+}
+
+static void bench_transmit_async (void) {
+    unsigned char data [XBEE_MAX_PAYLOAD];
+    xbee_completion_type c;
+    xbee_request_type req;
+    int sent, handle;
+
+    req.req = xbee_request_transmit;
+    req.radio = 0;
+    req.args.transmit.addr_hi = XBEE_EMU_SH;
+    req.args.transmit.addr = xbee_addr_unknown;
+    req.args.transmit.data_ptr = data;
+    req.args.transmit.data_size = bench_size;
+
+    for (sent = 0; bench_done < bench_count; ) {
+        if (xbee_get_completion (&c)) {
+            bench_complete (&c);
+            continue;
+        }
+
+        if (sent < bench_count && xbee_async_pending () < XBEE_ASYNC_SLOTS) {
+            req.args.transmit.addr_lo = XBEE_EMU_SL + 1 + sent % bench_peers;
+            bench_fill (data, bench_size, sent);
+            handle = xbee_submit (&req);
+            bench_submitted [handle] = host_time_ns ();
+            sent ++;
+            continue;
+        }
+
+        SynthOS_wait (xbee_get_completion (&c));
+        bench_complete (&c);
+    }
+}
+
+static void bench_receive (void) {
+    uint64_t t;
+    int r;
+
+    while (bench_done < bench_count) {
+        bench_recv.radio = 0;
+        bench_recv.buf_ptr = bench_buf;
+        bench_recv.buf_size = sizeof bench_buf;
+        r = SynthOS_call (xbee_receive_timed (&bench_recv, BENCH_TICKS));
+        if (r == xbee_timeout || r == 0)
+            /* The rest is lost */
+            break;
+        bench_done ++;
+        if (bench_recv.recv_size < sizeof t) {
+            bench_failed ++;
+            continue;
+        }
+        memcpy (&t, bench_buf, sizeof t);
+        bench_latency [bench_ok ++] = (uint32_t) ((host_time_ns () - t) / 1000);
+        bench_bytes += bench_recv.recv_size;
+    }
+}
+
+static void bench_main (void) {
+    if (!bench_wait_associated ()) {
+        fprintf (stderr, "xbee-bench: the radio did not join\n");
+        return;
+    }
+    bench_start = host_time_ns ();
+    if (bench_tx && bench_async)
+        bench_transmit_async ();
+    else if (bench_tx)
+        bench_transmit ();
+    else
+        bench_receive ();
+    bench_end = host_time_ns ();
+}
+
+/* The peers' traffic for the rx benchmark */
+static void bench_generator (void) {
+    unsigned char data [XBEE_MAX_PAYLOAD];
+    uint64_t next;
+    int i;
+
+    if (!bench_wait_associated ())
+        return;
+    next = host_time_ns ();
+    for (i = 0; i < bench_count; i ++) {
+        SynthOS_wait (host_time_ns () >= next);
+        bench_fill (data, bench_size, i);
+        xbee_emu_send (1 + i % bench_peers, 0, data, bench_size);
+        next += bench_interval * 1000ULL;
+    }
+}
+
+static int bench_compare (const void * a, const void * b) {
+    uint32_t x = * (const uint32_t *) a, y = * (const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static uint32_t bench_percentile (int p) {
+    return bench_ok != 0 ? bench_latency [(bench_ok - 1) * p / 100] : 0;
+}
+
+static void bench_report (void) {
+    xbee_emu_stats_type es;
+    xbee_stats_type ds;
+    double elapsed;
+
+    elapsed = (double) (bench_end - bench_start) / 1e9;
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+    qsort (bench_latency, bench_ok, sizeof bench_latency [0], bench_compare);
+    xbee_emu_get_stats (0, &es);
+    xbee_get_stats (0, &ds);
+
+    printf ("mode %s%s, peers %d, frames %d x %u bytes, delay %uus, loss %u/1000, retries %d, baud %lu\n",
+      bench_tx ? "tx" : "rx", bench_tx && bench_async ? " async" : "", bench_peers, bench_count, bench_size,
+      bench_cfg.delay_us, bench_cfg.loss, bench_cfg.retries, (unsigned long) bench_cfg.baudrate);
+    printf ("done %d: ok %d, failed %d, timed out %d, lost %d, in %.3f s\n",
+      bench_done, bench_ok, bench_failed, bench_timeouts, bench_count - bench_done, elapsed);
+    printf ("throughput: %.1f frames/s, %.1f payload bytes/s, %.1f UART bytes/s\n",
+      bench_ok / elapsed, bench_bytes / elapsed, (es.bytes_in + es.bytes_out) / elapsed);
+    printf ("latency us: p50 %lu, p90 %lu, p99 %lu, max %lu\n",
+      (unsigned long) bench_percentile (50), (unsigned long) bench_percentile (90),
+      (unsigned long) bench_percentile (99), (unsigned long) bench_percentile (100));
+    printf ("driver: tx %u frames, rx %u frames, dropped: checksum %u, no slot %u, unexpected %u\n",
+      ds.tx_frames, ds.rx_frames, ds.drop_checksum, ds.drop_no_slot, ds.drop_unexpected);
+}
+
+int main (int argc, char ** argv) {
+    int c;
+
+    while ((c = getopt (argc, argv, "m:n:c:s:d:l:r:b:i:aw:")) != -1)
+        switch (c) {
+          case 'm':
+            bench_tx = strcmp (optarg, "rx") != 0;
+            break;
+          case 'n':
+            bench_peers = atoi (optarg);
+            break;
+          case 'c':
+            bench_count = atoi (optarg);
+            break;
+          case 's':
+            bench_size = (unsigned) atoi (optarg);
+            break;
+          case 'd':
+            bench_cfg.delay_us = (unsigned) atoi (optarg);
+            break;
+          case 'l':
+            bench_cfg.loss = (unsigned) atoi (optarg);
+            break;
+          case 'r':
+            bench_cfg.retries = atoi (optarg);
+            break;
+          case 'b':
+            bench_cfg.baudrate = (uint32_t) atol (optarg);
+            break;
+          case 'i':
+            bench_interval = (unsigned) atoi (optarg);
+            break;
+          case 'a':
+            bench_async = 1;
+            break;
+          case 'w':
+#ifdef UART_CAPTURE
+            bench_capture_name = optarg;
+            break;
+#else
+            fprintf (stderr, "xbee-bench: -w needs UART_CAPTURE\n");
+            return 2;
+#endif
+          default:
+            fprintf (stderr,
+              "Usage: %s [-m tx|rx] [-n peers] [-c count] [-s size] [-d delay_us]"
+              " [-l loss] [-r retries] [-b baudrate] [-i interval_us] [-a] [-w file]\n", argv [0]);
+            return 2;
+        }
+    if (bench_peers < 1 || bench_peers >= XBEE_EMU_NODES || bench_count < 1) {
+        fprintf (stderr, "xbee-bench: bad peers or count\n");
+        return 2;
+    }
+    if (bench_size < 8)
+        bench_size = 8;
+    if (bench_size > XBEE_MAX_PAYLOAD)
+        bench_size = XBEE_MAX_PAYLOAD;
+    bench_latency = calloc (bench_count, sizeof bench_latency [0]);
+    if (bench_latency == NULL) {
+        perror ("xbee-bench");
+        return 1;
+    }
+
+#ifdef UART_CAPTURE
+    if (bench_capture_name != NULL) {
+        bench_capture_file = fopen (bench_capture_name, "wb");
+        if (bench_capture_file == NULL) {
+            perror (bench_capture_name);
+            return 2;
+        }
+    }
+#endif
+
+    bench_cfg.nodes = bench_peers + 1;
+    xbee_emu_config (&bench_cfg);
+    uart_posix_attach (0, xbee_emu_attach (0));
+    xbee_emu_start ();
+
+    synthos_task (bench_main, 0);
+    if (!bench_tx)
+        synthos_task (bench_generator, 0);
+    if (bench_async)
+        synthos_task (xbee_async, 1);
+#ifdef UART_RX_RING_SIZE
+    synthos_task (xbee_receiver, 1);
+#endif
+#ifdef UART_CAPTURE
+    if (bench_capture_file != NULL)
+        synthos_task (bench_capture, 1);
+#endif
+    synthos_run ();
+
+#ifdef UART_CAPTURE
+    if (bench_capture_file != NULL) {
+        bench_capture_write ();
+        fclose (bench_capture_file);
+        printf ("capture: %u entries lost\n", uart_capture_lost);
+    }
+#endif
+    bench_report ();
+    return bench_ok == 0;
+}
@@ -0,0 +1,94 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Monotonic time for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Kept apart from timer-posix.c: <time.h> declares clock ().
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "host.h"
+
+/* 64us units per clock tick, as on the target (see timer.h) */
+#define HOST_TICK 156
+
+static struct timespec host_start;
+static pthread_once_t host_start_once = PTHREAD_ONCE_INIT;
+static void (* host_tick) (void);
+
+/* Constructors of other units may need the time before ours would run */
+static void host_time_init (void) {
+    clock_gettime (CLOCK_MONOTONIC, &host_start);
+}
+
+uint64_t host_time (void) {
+    struct timespec now;
+    int64_t ns;
+
+    pthread_once (&host_start_once, host_time_init);
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    ns = (int64_t) (now.tv_sec - host_start.tv_sec) * 1000000000 + (now.tv_nsec - host_start.tv_nsec);
+    return (uint64_t) ns / 64000;
+}
+
+uint64_t host_time_ns (void) {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+static void * host_time_thread (void * arg) {
+    struct timespec next;
+    uint64_t ticks, ns;
+
+    (void) arg;
+    for (ticks = 1; ; ticks ++) {
+        /* Sleep to the tick boundary rather than for a tick, so that no drift builds up */
+        ns = ticks * HOST_TICK * 64000;
+        next.tv_sec = host_start.tv_sec + (time_t) (ns / 1000000000);
+        next.tv_nsec = host_start.tv_nsec + (long) (ns % 1000000000);
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_sec ++;
+            next.tv_nsec -= 1000000000;
+        }
+        while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) != 0)
+            ;
+
+        host_irq_enter ();
+        host_tick ();
+        host_irq_leave ();
+    }
+    return NULL;
+}
+
+void host_time_start (void (* tick) (void)) {
+    pthread_t thread;
+
+    pthread_once (&host_start_once, host_time_init);
+    host_tick = tick;
+    if (pthread_create (&thread, NULL, host_time_thread, NULL) != 0) {
+        perror ("host_time_start");
+        exit (1);
+    }
+    pthread_detach (thread);
+}
@@ -0,0 +1,74 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Host build interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * The interrupt mask is a recursive mutex. The tasks hold it while they
+ * run (as if they were interrupted only when they wait), threads that
+ * stand for interrupt handlers take it with host_irq_enter/host_irq_leave.
+ *
+ * Do not include <time.h> next to timer.h: "clock" clashes with clock ().
+ */
+#include <stdint.h>
+
+/**
+ * @brief  Starts a task
+ * @param  entry  task function
+ * @param  loop  nonzero for a loop task (called over and over),
+ *               0 for a task that is called once
+ */
+void synthos_task (void (* entry) (void), int loop);
+
+/**
+ * @brief  Runs the tasks
+ *
+ * Returns when all the tasks that are called once have returned;
+ * the loop tasks are left where they are.
+ */
+void synthos_run (void);
+
+void host_irq_enter (void);
+void host_irq_leave (void);
+
+/**
+ * @brief  Time since start in 64us units (CLOCK_MONOTONIC)
+ */
+uint64_t host_time (void);
+
+/**
+ * @brief  CLOCK_MONOTONIC in nanoseconds, for measurements
+ */
+uint64_t host_time_ns (void);
+
+/**
+ * @brief  Starts the thread that ticks the clock (see timer-posix.c)
+ * @param  tick  called with interrupts masked every clock tick
+ */
+void host_time_start (void (* tick) (void));
+
+/**
+ * @brief  Connects a UART port to a file descriptor
+ *
+ * A terminal is put to raw mode. Two threads move the bytes between the
+ * descriptor and uart_receive_byte/uart_transmit_byte, or the rings.
+ *
+ * @param  port  UART port
+ * @param  fd  descriptor open for reading and writing
+ */
+void uart_posix_attach (int port, int fd);
@@ -0,0 +1,127 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Host build test program
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Usage: xbee-host DEVICE [CMD[=HEX]]...
+ *
+ * Sends the AT commands (NP SH SL AI by default) to the radio on DEVICE
+ * (a serial port or a pseudo-terminal) and prints the responses.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "xbee.h"
+#include "host.h"
+
+/* Time limit for a single command, in clock ticks */
+#define HOST_TICKS 100
+
+static char * host_default_cmds [] = { "NP", "SH", "SL", "AI" };
+static char ** host_cmds;
+static int host_count, host_failures;
+
+static xbee_request_type host_req;
+static unsigned char host_data [32], host_buf [32];
+
+/* Parses "CMD" or "CMD=HEX" */
+static int host_parse (const char * arg) {
+    unsigned v;
+    size_t i;
+
+    if (strlen (arg) < 2 || (arg [2] != 0 && arg [2] != '='))
+        return 0;
+    host_req.req = xbee_request_at;
+    host_req.radio = 0;
+    host_req.args.at.cmd [0] = arg [0];
+    host_req.args.at.cmd [1] = arg [1];
+    host_req.args.at.data_ptr = host_data;
+    host_req.args.at.data_size = 0;
+    host_req.args.at.buf_ptr = host_buf;
+    host_req.args.at.buf_size = sizeof host_buf;
+
+    if (arg [2] == 0)
+        return 1;
+    for (i = 3; arg [i] != 0; i += 2) {
+        if (host_req.args.at.data_size == sizeof host_data || sscanf (arg + i, "%2x", &v) != 1)
+            return 0;
+        host_data [host_req.args.at.data_size ++] = (unsigned char) v;
+        if (arg [i + 1] == 0)
+            break;
+    }
+    return 1;
+}
+
+static void host_main (void) {
+    int i, r;
+    uint16_t j;
+
+    for (i = 0; i < host_count; i ++) {
+        if (!host_parse (host_cmds [i])) {
+            fprintf (stderr, "%s: bad command\n", host_cmds [i]);
+            host_failures ++;
+            continue;
+        }
+        r = SynthOS_call (xbee_request_timed (&host_req, HOST_TICKS));
+        if (r == xbee_timeout) {
+            printf ("AT%.2s: timeout\n", host_cmds [i]);
+            host_failures ++;
+            continue;
+        }
+        printf ("AT%.2s: status %u,", host_cmds [i], host_req.args.at.status);
+        for (j = 0; j < host_req.args.at.recv_size && j < sizeof host_buf; j ++)
+            printf (" %02X", host_buf [j]);
+        printf ("\n");
+        if (host_req.args.at.status != 0)
+            host_failures ++;
+    }
+}
+
+int main (int argc, char ** argv) {
+    int fd;
+
+    if (argc < 2) {
+        fprintf (stderr, "Usage: %s DEVICE [CMD[=HEX]]...\n", argv [0]);
+        return 2;
+    }
+    fd = open (argv [1], O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror (argv [1]);
+        return 2;
+    }
+    if (argc > 2) {
+        host_cmds = argv + 2;
+        host_count = argc - 2;
+    } else {
+        host_cmds = host_default_cmds;
+        host_count = sizeof host_default_cmds / sizeof host_default_cmds [0];
+    }
+
+    uart_posix_attach (0, fd);
+    synthos_task (host_main, 0);
+#ifdef UART_RX_RING_SIZE
+    synthos_task (xbee_receiver, 1);
+#endif
+    synthos_run ();
+
+    return host_failures != 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Replay of a UART capture through the driver
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Usage: xbee-replay [-s speed] [-p port] [-v] FILE
+ *
+ * FILE holds capture entries as uart_capture_dump sends them (see uart.h):
+ * 4 bytes each, time (lclock units from the previous entry, high byte
+ * first), flags, byte. The bytes received on "port" (default 0) are fed
+ * to uart_receive_byte of radio 0; the ones sent are counted only.
+ *
+ * speed: 1 - original timing (default), N - N times faster,
+ * 0 - as fast as the driver takes them. The tasks get a turn after
+ * every byte, so a replay at speed 0 always gives the same result.
+ *
+ * -v prints the frames the application gets and every drop, with the
+ * number of the byte it happened at.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "timer.h"
+#include "uart.h"
+#include "synthos-support.h"
+#include "xbee.h"
+#include "host.h"
+
+/* Same as on the target */
+#define REPLAY_TX           0x80
+#define REPLAY_GAP          0x10
+#define REPLAY_PORT         0x03
+
+/* Ticks the application gets to take the last frames */
+#define REPLAY_TICKS        10
+
+typedef struct {
+    uint32_t time;
+    unsigned char flags;
+    unsigned char byte;
+} replay_entry_type;
+
+static replay_entry_type * replay_entries;
+static size_t replay_count;
+static unsigned replay_speed = 1;
+static int replay_port, replay_verbose;
+
+static uint32_t replay_fed, replay_sent, replay_frames, replay_frame_bytes;
+static uint64_t replay_start, replay_end;
+
+static int replay_load (const char * name) {
+    unsigned char rec [4];
+    uint32_t gap = 0;
+    size_t cap = 0;
+    FILE * f;
+
+    f = fopen (name, "rb");
+    if (f == NULL) {
+        perror (name);
+        return 0;
+    }
+    while (fread (rec, sizeof rec, 1, f) == 1) {
+        if (rec [2] & REPLAY_GAP) {
+            /* The high 16 bits of the next entry's time */
+            gap = (uint32_t) rec [0] << 24 | (uint32_t) rec [1] << 16;
+            continue;
+        }
+        if (replay_count == cap) {
+            cap = cap != 0 ? cap * 2 : 1024;
+            replay_entries = realloc (replay_entries, cap * sizeof replay_entries [0]);
+            if (replay_entries == NULL) {
+                perror ("xbee-replay");
+                exit (1);
+            }
+        }
+        replay_entries [replay_count].time = gap | (uint32_t) rec [0] << 8 | rec [1];
+        gap = 0;
+        replay_entries [replay_count].flags = rec [2];
+        replay_entries [replay_count].byte = rec [3];
+        replay_count ++;
+    }
+    fclose (f);
+    return 1;
+}
+
+/* Prints the drop counters that went up */
+static void replay_drops (xbee_stats_type * last, uint32_t at) {
+    xbee_stats_type st;
+
+    xbee_get_stats (0, &st);
+#define REPLAY_DROP(name) \
+    if (st.name != last->name) \
+        printf ("byte %lu: " #name " %u\n", (unsigned long) at, (unsigned) (uint16_t) (st.name - last->name));
+    REPLAY_DROP (drop_partial)
+    REPLAY_DROP (drop_checksum)
+    REPLAY_DROP (drop_length)
+    REPLAY_DROP (drop_type)
+    REPLAY_DROP (drop_unexpected)
+    REPLAY_DROP (drop_no_slot)
+    REPLAY_DROP (truncated)
+#undef REPLAY_DROP
+    * last = st;
+}
+
+static void replay_feed (void) {
+    xbee_stats_type last;
+    timer_type wait;
+    uint64_t at;
+    size_t i;
+    int mask;
+
+    xbee_get_stats (0, &last);
+    replay_start = host_time_ns ();
+    at = replay_start;
+    for (i = 0; i < replay_count; i ++) {
+        if (i != 0 && replay_speed != 0) {
+            at += (uint64_t) replay_entries [i].time * 64000 / replay_speed;
+            SynthOS_wait (host_time_ns () >= at);
+        }
+        if ((replay_entries [i].flags & REPLAY_PORT) != replay_port)
+            continue;
+        if (replay_entries [i].flags & REPLAY_TX) {
+            replay_sent ++;
+            continue;
+        }
+
+        /* As the interrupt would */
+        mask = get_mask ();
+        uart_receive_byte (0, replay_entries [i].byte);
+        set_mask (mask);
+        replay_fed ++;
+
+        if (replay_verbose)
+            replay_drops (&last, replay_fed);
+        synthos_yield ();
+    }
+    replay_end = host_time_ns ();
+
+    timer_arm (&wait, REPLAY_TICKS);
+    SynthOS_wait (wait.fired);
+}
+
+/* This is a loop task: the last call is left waiting */
+static void replay_drain (void) {
+    xbee_frame_type * frame;
+    int r;
+
+    r = SynthOS_call (xbee_receive_frame (&frame));
+    if (r <= 0)
+        return;
+    replay_frames ++;
+    replay_frame_bytes += frame->size;
+    if (replay_verbose)
+        printf ("byte %lu: frame from %08lX%08lX, %u bytes\n", (unsigned long) replay_fed,
+          (unsigned long) frame->addr_hi, (unsigned long) frame->addr_lo, (unsigned) frame->size);
+    xbee_release_frame (frame);
+}
+
+static void replay_report (void) {
+    xbee_stats_type st;
+    double elapsed;
+
+    elapsed = (double) (replay_end - replay_start) / 1e9;
+    if (elapsed <= 0)
+        elapsed = 1e-9;
+    xbee_get_stats (0, &st);
+
+    printf ("entries %lu: %lu bytes fed, %lu sent bytes skipped, in %.3f s\n",
+      (unsigned long) replay_count, (unsigned long) replay_fed, (unsigned long) replay_sent, elapsed);
+    printf ("parse: %.1f bytes/s, %.1f ns/byte\n",
+      replay_fed / elapsed, replay_fed != 0 ? elapsed * 1e9 / replay_fed : 0.0);
+    printf ("frames: %u with a good checksum, %lu data frames taken (%lu bytes)\n",
+      st.rx_frames, (unsigned long) replay_frames, (unsigned long) replay_frame_bytes);
+    printf ("dropped: partial %u, checksum %u, length %u, type %u, unexpected %u, no slot %u, truncated %u\n",
+      st.drop_partial, st.drop_checksum, st.drop_length, st.drop_type,
+      st.drop_unexpected, st.drop_no_slot, st.truncated);
+}
+
+int main (int argc, char ** argv) {
+    int c, fd;
+
+    while ((c = getopt (argc, argv, "s:p:v")) != -1)
+        switch (c) {
+          case 's':
+            replay_speed = (unsigned) atoi (optarg);
+            break;
+          case 'p':
+            replay_port = atoi (optarg) & REPLAY_PORT;
+            break;
+          case 'v':
+            replay_verbose = 1;
+            break;
+          default:
+            optind = argc;
+            break;
+        }
+    if (optind != argc - 1) {
+        fprintf (stderr, "Usage: %s [-s speed] [-p port] [-v] FILE\n", argv [0]);
+        return 2;
+    }
+    if (!replay_load (argv [optind]))
+        return 2;
+
+    /* Nothing goes to the radio; the transmitter needs somewhere to write */
+    fd = open ("/dev/null", O_RDWR);
+    if (fd < 0) {
+        perror ("/dev/null");
+        return 2;
+    }
+    uart_posix_attach (0, fd);
+
+    /* The capture may start anywhere, well after the radio joined */
+    associated |= 1;
+
+    synthos_task (replay_feed, 0);
+    synthos_task (replay_drain, 1);
+    synthos_run ();
+
+    replay_report ();
+    return 0;
+}
@@ -0,0 +1,136 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Cooperative scheduler and interrupt mask for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <ucontext.h>
+
+#include "synthos-support.h"
+#include "host.h"
+
+#define SYNTHOS_TASKS       16
+#define SYNTHOS_STACK_SIZE  (64 * 1024)
+
+typedef struct {
+    ucontext_t context;
+    void (* entry) (void);
+    int loop;
+    int done;
+} synthos_task_type;
+
+static synthos_task_type synthos_tasks [SYNTHOS_TASKS];
+static int synthos_count, synthos_current;
+static ucontext_t synthos_scheduler;
+
+/* Statically initialized: interrupt threads may start from constructors */
+static pthread_mutex_t host_mask = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+/* Interrupt threads waiting for the mask */
+static volatile int host_irq_waiting;
+
+volatile unsigned char interrupt_count;
+
+/*
+ * Interrupts are disabled by taking the mask, enabled by giving it back.
+ * Calls nest the way get_mask/set_mask pairs do on the target.
+ */
+void enable_ints (void) {
+}
+
+int get_mask (void) {
+    pthread_mutex_lock (&host_mask);
+    return 0;
+}
+
+void set_mask (int mask) {
+    (void) mask;
+    pthread_mutex_unlock (&host_mask);
+}
+
+void host_irq_enter (void) {
+    __sync_fetch_and_add (&host_irq_waiting, 1);
+    pthread_mutex_lock (&host_mask);
+    __sync_fetch_and_sub (&host_irq_waiting, 1);
+    interrupt_count ++;
+}
+
+void host_irq_leave (void) {
+    pthread_mutex_unlock (&host_mask);
+}
+
+static void synthos_start (void) {
+    synthos_task_type * task = &synthos_tasks [synthos_current];
+
+    do
+        task->entry ();
+    while (task->loop);
+
+    task->done = 1;
+    swapcontext (&task->context, &synthos_scheduler);
+}
+
+void synthos_task (void (* entry) (void), int loop) {
+    synthos_task_type * task;
+
+    if (synthos_count == SYNTHOS_TASKS) {
+        fprintf (stderr, "synthos: too many tasks\n");
+        exit (1);
+    }
+    task = &synthos_tasks [synthos_count ++];
+    task->entry = entry;
+    task->loop = loop;
+    task->done = 0;
+
+    getcontext (&task->context);
+    task->context.uc_stack.ss_sp = malloc (SYNTHOS_STACK_SIZE);
+    task->context.uc_stack.ss_size = SYNTHOS_STACK_SIZE;
+    task->context.uc_link = NULL;
+    makecontext (&task->context, synthos_start, 0);
+}
+
+void synthos_yield (void) {
+    swapcontext (&synthos_tasks [synthos_current].context, &synthos_scheduler);
+}
+
+void synthos_run (void) {
+    int i, running;
+
+    get_mask ();
+    do {
+        running = 0;
+        for (i = 0; i < synthos_count; i ++) {
+            if (synthos_tasks [i].done)
+                continue;
+            synthos_current = i;
+            swapcontext (&synthos_scheduler, &synthos_tasks [i].context);
+            if (!synthos_tasks [i].loop && !synthos_tasks [i].done)
+                running = 1;
+        }
+
+        /* Let the interrupts in */
+        set_mask (0);
+        if (host_irq_waiting == 0)
+            sched_yield ();
+        while (host_irq_waiting != 0)
+            sched_yield ();
+        get_mask ();
+    } while (running);
+    set_mask (0);
+}
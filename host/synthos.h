@@ -0,0 +1,67 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         SynthOS primitives for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Included ahead of every source (-include synthos.h), in place of
+ * what the SynthOS generator produces for the target.
+ *
+ * Every task started with synthos_task runs on a stack of its own and
+ * gives control away in SynthOS_wait only, as it does on the target.
+ * A call task runs on the stack of its caller. Interrupts (see
+ * synthos-posix.c) are let in between the tasks' turns.
+ */
+#ifndef SYNTHOS_HOST_H
+#define SYNTHOS_HOST_H
+
+void synthos_yield (void);
+
+#define SynthOS_wait(cond) do { while (!(cond)) synthos_yield (); } while (0)
+#define SynthOS_call(task) (task)
+
+/* Task prototypes, as the SynthOS generator makes them from project.sop */
+#include <stdint.h>
+
+struct xbee_request;
+struct xbee_receive;
+struct xbee_frame;
+struct xbee_at_command;
+struct xbee_identity;
+struct xbee_stream;
+
+void xbee_request (struct xbee_request * req_ptr);
+int xbee_request_timed (struct xbee_request * req_ptr, unsigned ticks);
+int xbee_post (struct xbee_request * req_ptr);
+void xbee_wait (struct xbee_request * req_ptr);
+int xbee_receive (struct xbee_receive * recv_ptr);
+void xbee_negotiate_baudrate (uint32_t * rate_ptr);
+int xbee_at_batch (struct xbee_at_command * cmds, int count);
+int xbee_warm_start (struct xbee_identity * id_ptr);
+int xbee_request_many (struct xbee_request * reqs, int count, unsigned ticks);
+int xbee_receive_timed (struct xbee_receive * recv_ptr, unsigned ticks);
+int xbee_receive_frame (struct xbee_frame ** frame_ptr);
+void xbee_coalesce (struct xbee_request * req_ptr);
+void xbee_coalesce_flush (void);
+void xbee_coalescer (void);
+int xbee_stream_send (struct xbee_stream * st_ptr);
+int xbee_stream_receive (struct xbee_stream * st_ptr);
+void xbee_async (void);
+void xbee_receiver (void);
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Timer module for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Same interface as timer.c, and the same wheel (timer-wheel.h). The
+ * fine clock is CLOCK_MONOTONIC in 64us units (host_time), clock is
+ * ticked by a thread that stands for the TIMER2 compare interrupt.
+ */
+#include "timer.h"
+#include "timer-wheel.h"
+#include "synthos-support.h"
+#include "host.h"
+
+volatile unsigned clock;
+
+/* Timer "interrupt" */
+static void timer_tick (void) {
+    clock ++;
+    timer_wheel_tick ();
+}
+
+static void timer_init (void) __attribute__ ((constructor));
+static void timer_init (void) {
+    clock = 0;
+    host_time_start (timer_tick);
+}
+
+unsigned pclock (void) {
+    uint64_t t = host_time ();
+
+    return (unsigned) ((t / clock_divider) << 8 | t % clock_divider) & 0xFFFF;
+}
+
+unsigned pdiff (unsigned start, unsigned end) {
+    unsigned char h1 = (unsigned char) (start >> 8);
+    unsigned char l1 = (unsigned char) start;
+    unsigned char h2 = (unsigned char) (end >> 8);
+    unsigned char l2 = (unsigned char) end;
+    unsigned char dh = h2 - h1;
+    unsigned char dl = l2 - l1;
+    if (l2 < l1) {
+        dl += clock_divider;
+        dh --;
+    }
+    return (unsigned) dh * clock_divider + dl;
+}
+
+uint32_t lclock (void) {
+    return (uint32_t) host_time ();
+}
+
+uint32_t ldiff (uint32_t start, uint32_t end) {
+    return end - start;
+}
+
+int lafter (uint32_t a, uint32_t b) {
+    return (int32_t) (a - b) > 0;
+}
+
+void timer_arm (timer_type * t, unsigned ticks) {
+    int mask;
+
+    mask = get_mask ();
+    timer_wheel_arm (t, ticks);
+    set_mask (mask);
+}
+
+void timer_cancel (timer_type * t) {
+    int mask;
+
+    mask = get_mask ();
+    timer_wheel_cancel (t);
+    set_mask (mask);
+}
@@ -0,0 +1,230 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         UART module for the host build
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Same interface as uart.c, over a file descriptor: a serial port,
+ * a pseudo-terminal or one end of a socketpair (see uart_posix_attach).
+ * For each port, one thread stands for the "receive complete"
+ * interrupt and another one for the "data register empty" interrupt.
+ * The bytes go as fast as the descriptor takes them; the baud rate
+ * matters only for a real serial port.
+ *
+ * The rings and the capture (UART_TX_RING_SIZE, UART_RX_RING_SIZE,
+ * UART_CAPTURE) work as on the target; there are no overruns and
+ * frame errors to count. The bytes come in chunks, faster than any
+ * baud rate: the reader waits while the receive ring is full.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <termios.h>
+
+#include "uart.h"
+#include "synthos-support.h"
+#include "host.h"
+
+/* For the capture; timer.h cannot go next to <time.h> (see host.h) */
+uint32_t lclock (void);
+uint32_t ldiff (uint32_t start, uint32_t end);
+
+#include "uart-ring.h"
+
+/* Bytes moved per interrupt "entry" */
+#define UART_POSIX_CHUNK 64
+
+uint32_t uart_baudrate [UART_PORTS];
+
+static int uart_fd [UART_PORTS];
+static sem_t uart_tx_sem [UART_PORTS];
+
+static const struct {
+    uint32_t rate;
+    speed_t speed;
+} uart_speeds [] = {
+    {   1200UL, B1200 },
+    {   2400UL, B2400 },
+    {   4800UL, B4800 },
+    {   9600UL, B9600 },
+    {  19200UL, B19200 },
+    {  38400UL, B38400 },
+    {  57600UL, B57600 },
+    { 115200UL, B115200 },
+    { 230400UL, B230400 }
+};
+
+/* Any rate is exact, as far as the driver can tell */
+unsigned uart_baudrate_error (uint32_t rate) {
+    (void) rate;
+    return 0;
+}
+
+void uart_set_baudrate (int port, uint32_t rate) {
+    struct termios tio;
+    unsigned i;
+
+    uart_baudrate [port] = rate;
+
+    if (!isatty (uart_fd [port]) || tcgetattr (uart_fd [port], &tio) != 0)
+        return;
+    for (i = 0; i < sizeof uart_speeds / sizeof uart_speeds [0]; i ++)
+        if (uart_speeds [i].rate == rate) {
+            cfsetispeed (&tio, uart_speeds [i].speed);
+            cfsetospeed (&tio, uart_speeds [i].speed);
+            tcsetattr (uart_fd [port], TCSADRAIN, &tio);
+            return;
+        }
+}
+
+void uart_transmit (int port) {
+    sem_post (&uart_tx_sem [port]);
+}
+
+#ifdef UART_RX_RING_SIZE
+int uart_rx_get (int port) {
+    return uart_rx_take (port);
+}
+#endif
+
+#ifdef UART_CAPTURE
+int uart_capture_get (uart_capture_type * entry) {
+    int mask, r;
+
+    mask = get_mask ();
+    r = uart_capture_take (entry);
+    set_mask (mask);
+    return r;
+}
+#endif
+
+/* Called from interrupt */
+static void uart_posix_receive (int port, unsigned char byte) {
+#ifdef UART_CAPTURE
+    uart_capture (port, 0, byte);
+#endif
+#ifdef UART_RX_RING_SIZE
+    uart_rx_put (port, byte);
+#else
+    uart_receive_byte (port, byte);
+#endif
+}
+
+/* Called from interrupt */
+static int uart_posix_transmit (int port) {
+    int c;
+
+#ifdef UART_TX_RING_SIZE
+    c = uart_tx_take (port);
+#else
+    c = uart_transmit_byte (port);
+#endif
+#ifdef UART_CAPTURE
+    if (c != -1)
+        uart_capture (port, UART_CAPTURE_TX, (unsigned char) c);
+#endif
+    return c;
+}
+
+static void * uart_rx_thread (void * arg) {
+    int port = (int) (intptr_t) arg;
+    unsigned char buf [UART_POSIX_CHUNK];
+    ssize_t i, n;
+
+    for (;;) {
+        n = read (uart_fd [port], buf, sizeof buf);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            /* The other end is gone: the line stays quiet */
+            return NULL;
+
+        host_irq_enter ();
+        for (i = 0; i < n; i ++) {
+#ifdef UART_RX_RING_SIZE
+            /* The line does not outrun the task here: wait as RTS would */
+            while (uart_rx_count (port) == UART_RX_RING_MASK) {
+                host_irq_leave ();
+                sched_yield ();
+                host_irq_enter ();
+            }
+#endif
+            uart_posix_receive (port, buf [i]);
+        }
+        host_irq_leave ();
+    }
+}
+
+static void * uart_tx_thread (void * arg) {
+    int port = (int) (intptr_t) arg;
+    unsigned char buf [UART_POSIX_CHUNK];
+    ssize_t n, done, w;
+    int c;
+
+    for (;;) {
+        while (sem_wait (&uart_tx_sem [port]) != 0)
+            ;
+
+        /* Send until the driver has nothing more */
+        do {
+            n = 0;
+            host_irq_enter ();
+            while (n < (ssize_t) sizeof buf && (c = uart_posix_transmit (port)) != -1)
+                buf [n ++] = (unsigned char) c;
+            host_irq_leave ();
+
+            for (done = 0; done < n; done += w) {
+                w = write (uart_fd [port], buf + done, n - done);
+                if (w < 0 && errno == EINTR)
+                    w = 0;
+                else if (w < 0)
+                    /* The other end is gone: the bytes are lost */
+                    break;
+            }
+        } while (n == (ssize_t) sizeof buf);
+    }
+    return NULL;
+}
+
+void uart_posix_attach (int port, int fd) {
+    struct termios tio;
+    pthread_t thread;
+
+    uart_fd [port] = fd;
+    sem_init (&uart_tx_sem [port], 0, 0);
+
+    if (isatty (fd) && tcgetattr (fd, &tio) == 0) {
+        cfmakeraw (&tio);
+        tcsetattr (fd, TCSANOW, &tio);
+    }
+    uart_set_baudrate (port, UART_BAUDRATE);
+
+    if (
+      pthread_create (&thread, NULL, uart_rx_thread, (void *) (intptr_t) port) != 0 ||
+      pthread_detach (thread) != 0 ||
+      pthread_create (&thread, NULL, uart_tx_thread, (void *) (intptr_t) port) != 0 ||
+      pthread_detach (thread) != 0
+    ) {
+        perror ("uart_posix_attach");
+        exit (1);
+    }
+}
@@ -0,0 +1,736 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee module emulator
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * One thread runs the whole mesh. What happens on the air is kept as
+ * events (frames for a node at a given time) in a heap; the bytes for
+ * an attached node go through its output queue, paced by the baud rate.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "uart.h"
+#include "xbee-emu.h"
+
+/* Largest frame (type and header included) the modules take or make */
+#define EMU_FRAME_MAX       300
+
+/* Time a module takes to answer a local AT command, and to restart */
+#define EMU_AT_NS           100000ULL
+#define EMU_RESET_NS        100000000ULL
+
+typedef struct {
+    uint64_t time;
+    int node;           /* recipient */
+    int from;           /* sender of RF data (0x90), otherwise -1 */
+    unsigned size;
+    unsigned char frame []; /* API frame: type and header, no length or checksum */
+} emu_event_type;
+
+typedef enum {
+    emu_parse_idle,
+    emu_parse_length_1,
+    emu_parse_length_2,
+    emu_parse_frame,
+    emu_parse_checksum
+} emu_parse_type;
+
+typedef struct {
+    int attached;
+    int fd;                 /* emulator's end of the socketpair */
+
+    /* Escaped bytes for the driver */
+    unsigned char * out;
+    size_t out_head, out_size, out_cap;
+    uint64_t out_time;      /* when the next byte may go (baud rate) */
+
+    /* Bytes from the driver */
+    emu_parse_type parse;
+    int esc;
+    unsigned length, pos;
+    unsigned char sum;
+    unsigned char in [EMU_FRAME_MAX];
+
+    unsigned char routes [XBEE_EMU_NODES]; /* route to the node is known */
+    xbee_emu_stats_type stats;
+} emu_node_type;
+
+static xbee_emu_config_type emu_cfg;
+static emu_node_type emu_nodes [XBEE_EMU_NODES];
+static unsigned emu_delay [XBEE_EMU_NODES][XBEE_EMU_NODES]; /* microseconds */
+static unsigned emu_loss [XBEE_EMU_NODES][XBEE_EMU_NODES];  /* per mille */
+
+static emu_event_type ** emu_heap;
+static size_t emu_heap_size, emu_heap_cap;
+
+/* The callback may send: recursive */
+static pthread_mutex_t emu_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static int emu_wake [2];
+
+static uint64_t emu_now (void) {
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+static void * emu_alloc (size_t size) {
+    void * p = malloc (size);
+
+    if (p == NULL) {
+        perror ("xbee-emu");
+        exit (1);
+    }
+    return p;
+}
+
+static void emu_heap_push (emu_event_type * ev) {
+    size_t i, parent;
+
+    if (emu_heap_size == emu_heap_cap) {
+        emu_heap_cap = emu_heap_cap != 0 ? emu_heap_cap * 2 : 64;
+        emu_heap = realloc (emu_heap, emu_heap_cap * sizeof emu_heap [0]);
+        if (emu_heap == NULL) {
+            perror ("xbee-emu");
+            exit (1);
+        }
+    }
+    for (i = emu_heap_size ++; i > 0; i = parent) {
+        parent = (i - 1) / 2;
+        if (emu_heap [parent]->time <= ev->time)
+            break;
+        emu_heap [i] = emu_heap [parent];
+    }
+    emu_heap [i] = ev;
+}
+
+static emu_event_type * emu_heap_pop (void) {
+    emu_event_type * top = emu_heap [0], * last = emu_heap [-- emu_heap_size];
+    size_t i, child;
+
+    for (i = 0; (child = 2 * i + 1) < emu_heap_size; i = child) {
+        if (child + 1 < emu_heap_size && emu_heap [child + 1]->time < emu_heap [child]->time)
+            child ++;
+        if (last->time <= emu_heap [child]->time)
+            break;
+        emu_heap [i] = emu_heap [child];
+    }
+    if (emu_heap_size != 0)
+        emu_heap [i] = last;
+    return top;
+}
+
+/* Schedules a frame for a node */
+static void emu_post (uint64_t time, int node, int from, const unsigned char * frame, unsigned size) {
+    emu_event_type * ev = emu_alloc (sizeof * ev + size);
+
+    ev->time = time;
+    ev->node = node;
+    ev->from = from;
+    ev->size = size;
+    memcpy (ev->frame, frame, size);
+    emu_heap_push (ev);
+}
+
+static void emu_out_byte (emu_node_type * n, unsigned char byte) {
+    if (n->out_head + n->out_size == n->out_cap) {
+        if (n->out_head != 0) {
+            memmove (n->out, n->out + n->out_head, n->out_size);
+            n->out_head = 0;
+        }
+        if (n->out_size == n->out_cap) {
+            n->out_cap = n->out_cap != 0 ? n->out_cap * 2 : 4096;
+            n->out = realloc (n->out, n->out_cap);
+            if (n->out == NULL) {
+                perror ("xbee-emu");
+                exit (1);
+            }
+        }
+    }
+    n->out [n->out_head + n->out_size ++] = byte;
+}
+
+/* API mode 2: everything after the frame mark is escaped */
+static void emu_out_escaped (emu_node_type * n, unsigned char byte) {
+    if (byte == 0x7E || byte == 0x7D || byte == 0x11 || byte == 0x13) {
+        emu_out_byte (n, 0x7D);
+        emu_out_byte (n, byte ^ 0x20);
+    } else
+        emu_out_byte (n, byte);
+}
+
+static void emu_out_frame (emu_node_type * n, const unsigned char * frame, unsigned size, uint64_t now) {
+    unsigned char sum = 0;
+    unsigned i;
+
+    if (n->out_size == 0 && n->out_time < now)
+        n->out_time = now;
+
+    emu_out_byte (n, 0x7E);
+    emu_out_escaped (n, (unsigned char) (size >> 8));
+    emu_out_escaped (n, (unsigned char) size);
+    for (i = 0; i < size; i ++) {
+        emu_out_escaped (n, frame [i]);
+        sum += frame [i];
+    }
+    emu_out_escaped (n, 0xFF - sum);
+    n->stats.frames_out ++;
+}
+
+static void emu_put32 (unsigned char * p, uint32_t v) {
+    p [0] = (unsigned char) (v >> 24);
+    p [1] = (unsigned char) (v >> 16);
+    p [2] = (unsigned char) (v >> 8);
+    p [3] = (unsigned char) v;
+}
+
+static uint32_t emu_get32 (const unsigned char * p) {
+    return (uint32_t) p [0] << 24 | (uint32_t) p [1] << 16 | (uint32_t) p [2] << 8 | p [3];
+}
+
+/* Node by its 64 and 16 bit addresses, -1 if there is no such node */
+static int emu_find (uint32_t hi, uint32_t lo, uint16_t addr) {
+    if (hi == XBEE_EMU_SH && lo - XBEE_EMU_SL < (uint32_t) emu_cfg.nodes)
+        return (int) (lo - XBEE_EMU_SL);
+    if (hi == 0 && lo == 0)
+        /* The coordinator */
+        return 0;
+    if (hi == 0xFFFFFFFFUL && lo == 0xFFFFFFFFUL && addr < emu_cfg.nodes)
+        /* 64 bit address unknown */
+        return addr;
+    return -1;
+}
+
+/* BD of the attached nodes: a code for the standard rates; unpaced ones report the driver's default */
+static int emu_bd (unsigned char * value) {
+    static const uint32_t rates [] = { 1200, 2400, 4800, 9600, 19200, 38400, 57600, 115200 };
+    uint32_t rate;
+    unsigned i;
+
+    rate = emu_cfg.baudrate != 0 ? emu_cfg.baudrate : UART_BAUDRATE;
+    for (i = 0; i < sizeof rates / sizeof rates [0]; i ++)
+        if (rates [i] == rate) {
+            value [0] = (unsigned char) i;
+            return 1;
+        }
+    emu_put32 (value, rate);
+    return 4;
+}
+
+/* Value of a parameter, its size or -1 if it is not known */
+static int emu_at_value (int node, const unsigned char * cmd, unsigned char * value) {
+    switch (cmd [0] << 8 | cmd [1]) {
+      case 'S' << 8 | 'H':
+        emu_put32 (value, XBEE_EMU_SH);
+        return 4;
+      case 'S' << 8 | 'L':
+        emu_put32 (value, XBEE_EMU_SL + node);
+        return 4;
+      case 'M' << 8 | 'Y':
+        value [0] = 0;
+        value [1] = (unsigned char) node;
+        return 2;
+      case 'N' << 8 | 'P':
+        value [0] = 0;
+        value [1] = 0x54;
+        return 2;
+      case 'A' << 8 | 'I':
+        value [0] = 0;
+        return 1;
+      case 'A' << 8 | 'P':
+        value [0] = 2;
+        return 1;
+      case 'B' << 8 | 'D':
+        return emu_bd (value);
+      default:
+        return -1;
+    }
+}
+
+static void emu_modem_status (uint64_t time, int node, unsigned char status) {
+    unsigned char frame [2];
+
+    frame [0] = 0x8A;
+    frame [1] = status;
+    emu_post (time, node, -1, frame, sizeof frame);
+}
+
+/* 0x8B for the sender of a transmit */
+static void emu_transmit_status (
+  uint64_t time, int node, unsigned char id, uint16_t addr,
+  unsigned char retries, unsigned char delivery, unsigned char discovery
+) {
+    unsigned char frame [7];
+
+    if (id == 0)
+        return;
+    frame [0] = 0x8B;
+    frame [1] = id;
+    frame [2] = (unsigned char) (addr >> 8);
+    frame [3] = (unsigned char) addr;
+    frame [4] = retries;
+    frame [5] = delivery;
+    frame [6] = discovery;
+    emu_post (time, node, -1, frame, sizeof frame);
+}
+
+/* 0x90 for the recipient */
+static void emu_deliver (uint64_t time, int to, int from, unsigned char options, const unsigned char * data, unsigned size) {
+    unsigned char frame [EMU_FRAME_MAX];
+
+    frame [0] = 0x90;
+    emu_put32 (frame + 1, XBEE_EMU_SH);
+    emu_put32 (frame + 5, XBEE_EMU_SL + from);
+    frame [9] = 0;
+    frame [10] = (unsigned char) from;
+    frame [11] = options;
+    memcpy (frame + 12, data, size);
+    emu_post (time, to, from, frame, 12 + size);
+}
+
+static int emu_lost (int from, int to) {
+    return emu_loss [from][to] != 0 && (unsigned) rand_r (&emu_cfg.seed) % 1000 < emu_loss [from][to];
+}
+
+/* Sends RF data from a node, "id" 0 - no status */
+static void emu_transmit (
+  uint64_t now, int from, unsigned char id, uint32_t hi, uint32_t lo, uint16_t addr,
+  const unsigned char * data, unsigned size
+) {
+    emu_node_type * n = &emu_nodes [from];
+    uint64_t t, rtt;
+    unsigned char discovery = 0;
+    int to, k;
+
+    if (size > EMU_FRAME_MAX - 12) {
+        /* Payload too large */
+        emu_transmit_status (now, from, id, 0xFFFE, 0, 0x74, 0);
+        n->stats.failed ++;
+        return;
+    }
+
+    if (hi == 0 && lo == 0xFFFF) {
+        /* Broadcast: one attempt to everybody */
+        for (to = 0; to < emu_cfg.nodes; to ++)
+            if (to != from && !emu_lost (from, to))
+                emu_deliver (now + emu_delay [from][to] * 1000ULL, to, from, 0x02, data, size);
+        emu_transmit_status (now + emu_cfg.delay_us * 1000ULL, from, id, 0xFFFE, 0, 0x00, 0x00);
+        n->stats.delivered ++;
+        return;
+    }
+
+    to = emu_find (hi, lo, addr);
+    if (to < 0 || to == from) {
+        emu_transmit_status (now + 2000ULL * emu_cfg.delay_us, from, id, 0xFFFE, 0, 0x24, 0x01);
+        n->stats.failed ++;
+        return;
+    }
+
+    rtt = 2000ULL * emu_delay [from][to];
+    t = now;
+    if (addr == 0xFFFE) {
+        discovery |= 0x01;
+        t += rtt;
+    }
+    if (!n->routes [to]) {
+        discovery |= 0x02;
+        t += rtt;
+        n->routes [to] = 1;
+    }
+    for (k = 0; k <= emu_cfg.retries; k ++) {
+        if (!emu_lost (from, to))
+            break;
+        n->stats.lost ++;
+        t += rtt;
+    }
+    if (k > emu_cfg.retries) {
+        emu_transmit_status (t, from, id, (uint16_t) to, (unsigned char) emu_cfg.retries, 0x21, discovery);
+        n->stats.failed ++;
+        return;
+    }
+    emu_deliver (t + rtt / 2, to, from, 0x01, data, size);
+    emu_transmit_status (t + rtt, from, id, (uint16_t) to, (unsigned char) k, 0x00, discovery);
+    n->stats.delivered ++;
+}
+
+/* A complete frame from the driver */
+static void emu_frame (int node, const unsigned char * f, unsigned size, uint64_t now) {
+    emu_node_type * n = &emu_nodes [node];
+    unsigned char frame [EMU_FRAME_MAX];
+    uint64_t rtt;
+    int to, r;
+
+    switch (f [0]) {
+      case 0x08:
+      case 0x09:
+        if (size < 4)
+            break;
+        frame [0] = 0x88;
+        frame [1] = f [1];
+        frame [2] = f [2];
+        frame [3] = f [3];
+        frame [4] = 0;
+        r = size == 4 ? emu_at_value (node, f + 2, frame + 5) : -1;
+        if (r < 0)
+            /* Setting, or a parameter we do not keep */
+            r = 0;
+        if (f [1] != 0)
+            emu_post (now + EMU_AT_NS, node, -1, frame, 5 + r);
+        if (f [2] == 'F' && f [3] == 'R') {
+            emu_modem_status (now + EMU_AT_NS + EMU_RESET_NS, node, 0x01);
+            emu_modem_status (now + EMU_AT_NS + 2 * EMU_RESET_NS, node, 0x02);
+        }
+        n->stats.frames_in ++;
+        return;
+      case 0x10:
+        if (size < 14)
+            break;
+        emu_transmit (now, node, f [1], emu_get32 (f + 2), emu_get32 (f + 6), (uint16_t) (f [10] << 8 | f [11]), f + 14, size - 14);
+        n->stats.frames_in ++;
+        return;
+      case 0x17:
+        if (size < 15)
+            break;
+        to = emu_find (emu_get32 (f + 2), emu_get32 (f + 6), (uint16_t) (f [10] << 8 | f [11]));
+        frame [0] = 0x97;
+        frame [1] = f [1];
+        if (to < 0 || to == node || emu_lost (node, to)) {
+            memcpy (frame + 2, f + 2, 10);
+            frame [12] = f [13];
+            frame [13] = f [14];
+            frame [14] = 0x04;
+            r = 0;
+            rtt = 2000ULL * emu_cfg.delay_us * (emu_cfg.retries + 1);
+        } else {
+            emu_put32 (frame + 2, XBEE_EMU_SH);
+            emu_put32 (frame + 6, XBEE_EMU_SL + to);
+            frame [10] = 0;
+            frame [11] = (unsigned char) to;
+            frame [12] = f [13];
+            frame [13] = f [14];
+            frame [14] = 0;
+            r = size == 15 ? emu_at_value (to, f + 13, frame + 15) : -1;
+            if (r < 0)
+                r = 0;
+            rtt = 2000ULL * emu_delay [node][to];
+        }
+        if (f [1] != 0)
+            emu_post (now + rtt, node, -1, frame, 15 + r);
+        n->stats.frames_in ++;
+        return;
+    }
+    n->stats.bad_frames ++;
+}
+
+/* Bytes from the driver */
+static void emu_input (int node, const unsigned char * buf, size_t size, uint64_t now) {
+    emu_node_type * n = &emu_nodes [node];
+    unsigned char byte;
+    size_t i;
+
+    n->stats.bytes_in += size;
+    for (i = 0; i < size; i ++) {
+        byte = buf [i];
+        if (byte == 0x7E) {
+            n->parse = emu_parse_length_1;
+            n->esc = 0;
+            continue;
+        }
+        if (n->parse == emu_parse_idle)
+            continue;
+        if (byte == 0x7D) {
+            n->esc = 1;
+            continue;
+        }
+        if (n->esc) {
+            byte ^= 0x20;
+            n->esc = 0;
+        }
+        switch (n->parse) {
+          case emu_parse_length_1:
+            n->length = (unsigned) byte << 8;
+            n->parse = emu_parse_length_2;
+            break;
+          case emu_parse_length_2:
+            n->length |= byte;
+            n->pos = 0;
+            n->sum = 0;
+            if (n->length == 0 || n->length > EMU_FRAME_MAX) {
+                n->stats.bad_frames ++;
+                n->parse = emu_parse_idle;
+            } else
+                n->parse = emu_parse_frame;
+            break;
+          case emu_parse_frame:
+            n->in [n->pos ++] = byte;
+            n->sum += byte;
+            if (n->pos == n->length)
+                n->parse = emu_parse_checksum;
+            break;
+          case emu_parse_checksum:
+            if ((unsigned char) (n->sum + byte) == 0xFF)
+                emu_frame (node, n->in, n->length, now);
+            else
+                n->stats.bad_frames ++;
+            n->parse = emu_parse_idle;
+            break;
+          default:
+            break;
+        }
+    }
+}
+
+/* Frames that are due */
+static void emu_dispatch (uint64_t now) {
+    emu_event_type * ev;
+    emu_node_type * n;
+
+    while (emu_heap_size != 0 && emu_heap [0]->time <= now) {
+        ev = emu_heap_pop ();
+        n = &emu_nodes [ev->node];
+        if (n->attached)
+            emu_out_frame (n, ev->frame, ev->size, now);
+        else if (ev->frame [0] == 0x90 && emu_cfg.receive != NULL)
+            emu_cfg.receive (ev->node, ev->from, ev->frame + 12, ev->size - 12);
+        free (ev);
+    }
+}
+
+/* Writes what the baud rate allows; returns ns to wait, 0 - nothing to wait for */
+static uint64_t emu_flush (emu_node_type * n, uint64_t now) {
+    uint64_t byte_ns = 0, allowed;
+    size_t size;
+    ssize_t w;
+
+    if (n->out_size == 0)
+        return 0;
+
+    size = n->out_size;
+    if (emu_cfg.baudrate != 0) {
+        /* 10 bits a byte */
+        byte_ns = 10000000000ULL / emu_cfg.baudrate;
+        if (n->out_time > now)
+            return n->out_time - now;
+        allowed = (now - n->out_time) / byte_ns + 1;
+        if (allowed < size)
+            size = (size_t) allowed;
+    }
+
+    w = write (n->fd, n->out + n->out_head, size);
+    if (w < 0)
+        return 0;
+    n->out_head += (size_t) w;
+    n->out_size -= (size_t) w;
+    n->stats.bytes_out += (uint32_t) w;
+    if (n->out_size == 0)
+        n->out_head = 0;
+    if (emu_cfg.baudrate != 0) {
+        n->out_time += (uint64_t) w * byte_ns;
+        if (n->out_size != 0 && n->out_time > now)
+            return n->out_time - now;
+    }
+    return 0;
+}
+
+static void * emu_thread (void * arg) {
+    struct pollfd fds [XBEE_EMU_NODES + 1];
+    int nodes [XBEE_EMU_NODES + 1];
+    unsigned char buf [256];
+    uint64_t now, wait, w;
+    ssize_t r;
+    int i, count, timeout;
+
+    (void) arg;
+    for (;;) {
+        pthread_mutex_lock (&emu_lock);
+        now = emu_now ();
+        emu_dispatch (now);
+
+        wait = emu_heap_size != 0 ? emu_heap [0]->time - now : 1000000000ULL;
+        fds [0].fd = emu_wake [0];
+        fds [0].events = POLLIN;
+        count = 1;
+        for (i = 0; i < emu_cfg.nodes; i ++) {
+            if (!emu_nodes [i].attached)
+                continue;
+            w = emu_flush (&emu_nodes [i], now);
+            if (w != 0 && w < wait)
+                wait = w;
+            fds [count].fd = emu_nodes [i].fd;
+            fds [count].events = POLLIN;
+            if (w == 0 && emu_nodes [i].out_size != 0)
+                fds [count].events |= POLLOUT;
+            nodes [count ++] = i;
+        }
+        pthread_mutex_unlock (&emu_lock);
+
+        /* Round up to a millisecond, the timer resolution of poll */
+        timeout = (int) ((wait + 999999) / 1000000);
+        if (poll (fds, count, timeout) < 0 && errno != EINTR) {
+            perror ("xbee-emu");
+            exit (1);
+        }
+
+        if (fds [0].revents & POLLIN)
+            while (read (emu_wake [0], buf, sizeof buf) > 0)
+                ;
+
+        pthread_mutex_lock (&emu_lock);
+        now = emu_now ();
+        for (i = 1; i < count; i ++)
+            if (fds [i].revents & POLLIN) {
+                r = read (fds [i].fd, buf, sizeof buf);
+                if (r > 0)
+                    emu_input (nodes [i], buf, (size_t) r, now);
+                else if (r == 0)
+                    /* The driver is gone */
+                    emu_nodes [nodes [i]].attached = 0;
+            }
+        pthread_mutex_unlock (&emu_lock);
+    }
+    return NULL;
+}
+
+static void emu_poke (void) {
+    unsigned char c = 0;
+
+    if (write (emu_wake [1], &c, 1) < 0 && errno != EAGAIN)
+        perror ("xbee-emu");
+}
+
+/**
+ * @brief  Sets the emulator up, before anything else
+ * @param  cfg  configuration (see @ref xbee_emu_config_type)
+ */
+void xbee_emu_config (const xbee_emu_config_type * cfg) {
+    int i, j;
+
+    emu_cfg = * cfg;
+    if (emu_cfg.nodes > XBEE_EMU_NODES)
+        emu_cfg.nodes = XBEE_EMU_NODES;
+    for (i = 0; i < XBEE_EMU_NODES; i ++)
+        for (j = 0; j < XBEE_EMU_NODES; j ++) {
+            emu_delay [i][j] = cfg->delay_us;
+            emu_loss [i][j] = cfg->loss;
+        }
+}
+
+/**
+ * @brief  Connects a node to a driver port
+ * @param  node  the node
+ * @return  descriptor for uart_posix_attach
+ */
+int xbee_emu_attach (int node) {
+    int sv [2];
+
+    if (socketpair (AF_UNIX, SOCK_STREAM, 0, sv) != 0) {
+        perror ("xbee-emu");
+        exit (1);
+    }
+    fcntl (sv [0], F_SETFL, O_NONBLOCK);
+    emu_nodes [node].fd = sv [0];
+    emu_nodes [node].attached = 1;
+    return sv [1];
+}
+
+/**
+ * @brief  Sets up the link from one node to another
+ * @param  from  sender
+ * @param  to  recipient
+ * @param  delay_us  one-way delay, microseconds
+ * @param  loss  loss rate, per mille per attempt
+ */
+void xbee_emu_link (int from, int to, unsigned delay_us, unsigned loss) {
+    pthread_mutex_lock (&emu_lock);
+    emu_delay [from][to] = delay_us;
+    emu_loss [from][to] = loss;
+    pthread_mutex_unlock (&emu_lock);
+}
+
+/**
+ * @brief  Starts the emulator thread; the attached nodes report "joined"
+ */
+void xbee_emu_start (void) {
+    pthread_t thread;
+    uint64_t now;
+    int i;
+
+    if (pipe2 (emu_wake, O_NONBLOCK) != 0) {
+        perror ("xbee-emu");
+        exit (1);
+    }
+    now = emu_now ();
+    for (i = 0; i < emu_cfg.nodes; i ++)
+        if (emu_nodes [i].attached)
+            emu_modem_status (now, i, 0x02);
+    if (pthread_create (&thread, NULL, emu_thread, NULL) != 0) {
+        perror ("xbee-emu");
+        exit (1);
+    }
+    pthread_detach (thread);
+}
+
+/**
+ * @brief  Sends RF data from a virtual node
+ * @param  from  sender
+ * @param  to  recipient, -1 - broadcast
+ * @param  data  payload
+ * @param  size  payload size
+ */
+void xbee_emu_send (int from, int to, const void * data, unsigned size) {
+    pthread_mutex_lock (&emu_lock);
+    if (to < 0)
+        emu_transmit (emu_now (), from, 0, 0, 0xFFFF, 0xFFFE, data, size);
+    else
+        emu_transmit (emu_now (), from, 0, XBEE_EMU_SH, XBEE_EMU_SL + to, (uint16_t) to, data, size);
+    pthread_mutex_unlock (&emu_lock);
+    emu_poke ();
+}
+
+/**
+ * @brief  Makes a node report its state with 0x8A
+ * @param  node  the node
+ * @param  status  modem status
+ */
+void xbee_emu_modem_status (int node, unsigned char status) {
+    pthread_mutex_lock (&emu_lock);
+    emu_modem_status (emu_now (), node, status);
+    pthread_mutex_unlock (&emu_lock);
+    emu_poke ();
+}
+
+/**
+ * @brief  Get the statistics of a node
+ * @param  node  the node
+ * @param  [out] st  statistics
+ */
+void xbee_emu_get_stats (int node, xbee_emu_stats_type * st) {
+    pthread_mutex_lock (&emu_lock);
+    * st = emu_nodes [node].stats;
+    pthread_mutex_unlock (&emu_lock);
+}
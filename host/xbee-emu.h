@@ -0,0 +1,90 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee module emulator interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * A mesh of emulated XBee (ZigBee) modules in API mode 2 (escaped).
+ * A node is either attached to a driver port through a socketpair
+ * (xbee_emu_attach), or virtual: its traffic is made and consumed by
+ * the program (xbee_emu_send and the "receive" callback).
+ *
+ * The modules answer:
+ *   0x08, 0x09 (AT command)     with 0x88: SH, SL, MY, NP, AI, AP, BD
+ *                                and FR are known, anything else is "OK";
+ *   0x10 (transmit request)     with 0x8B after the retries, and 0x90
+ *                                at the recipient;
+ *   0x17 (remote AT command)    with 0x97, as the remote module would.
+ * 0x8A (joined) is sent when the emulator starts and after FR.
+ *
+ * Node n has SH = XBEE_EMU_SH, SL = XBEE_EMU_SL + n, MY = n (node 0 is
+ * the coordinator). Every link has a one-way delay and a loss rate per
+ * attempt. An attempt takes the delay there and back; a transmit is
+ * tried 1 + retries times before it fails with 0x21. The first transmit
+ * on a link costs a route discovery (another round trip), and one sent
+ * to 16 bit address 0xFFFE an address discovery.
+ */
+#include <stdint.h>
+
+#define XBEE_EMU_SH         0x0013A200UL
+#define XBEE_EMU_SL         0x40000000UL
+#define XBEE_EMU_NODES      32
+
+/**
+ * @brief Emulator configuration (see @ref xbee_emu_start)
+ * @param  nodes  number of nodes, up to XBEE_EMU_NODES
+ * @param  baudrate  UART speed of the attached nodes towards the driver,
+ *                   0 - as fast as the driver takes the bytes
+ * @param  delay_us  one-way delay of every link, microseconds
+ * @param  loss  loss rate of every link, per mille per attempt
+ * @param  retries  retries after the first attempt
+ * @param  seed  random seed for the losses
+ * @param  receive  called from the emulator thread with RF data
+ *                  for a virtual node
+ */
+typedef struct xbee_emu_config {
+    int nodes;
+    uint32_t baudrate;
+    unsigned delay_us;
+    unsigned loss;
+    int retries;
+    unsigned seed;
+    void (* receive) (int node, int from, const unsigned char * data, unsigned size);
+} xbee_emu_config_type;
+
+/**
+ * @brief Emulator statistics of a node (see @ref xbee_emu_get_stats)
+ */
+typedef struct xbee_emu_stats {
+    /** @brief Frames taken from the driver and frames sent to it */
+    uint32_t frames_in, frames_out;
+    /** @brief Bytes taken from the driver and sent to it, escapes included */
+    uint32_t bytes_in, bytes_out;
+    /** @brief Frames from the driver with a bad checksum or of unknown type */
+    uint32_t bad_frames;
+    /** @brief Transmits delivered, transmits failed, attempts lost */
+    uint32_t delivered, failed, lost;
+} xbee_emu_stats_type;
+
+void xbee_emu_config (const xbee_emu_config_type * cfg);
+int xbee_emu_attach (int node);
+void xbee_emu_link (int from, int to, unsigned delay_us, unsigned loss);
+void xbee_emu_start (void);
+void xbee_emu_send (int from, int to, const void * data, unsigned size);
+void xbee_emu_modem_status (int node, unsigned char status);
+void xbee_emu_get_stats (int node, xbee_emu_stats_type * st);
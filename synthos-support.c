@@ -21,6 +21,8 @@
 
 #include "synthos-support.h"
 
+volatile unsigned char interrupt_count;
+
 /*
  * As SynthOS user manual states, the following functions
  * are needed for a system that uses interrupt.
@@ -1,3 +1,6 @@
 void enable_ints (void);
 int get_mask (void);
 void set_mask (int mask);
+
+/* Counts the interrupts taken, wrapping around (see xbee_cpu_idle) */
+extern volatile unsigned char interrupt_count;
@@ -21,12 +21,28 @@
 #include <util/delay.h>
 
 #include "xbee.h"
+#include "xbee-config.h"
+#ifdef XBEE_POWER
+#include "xbee-power.h"
+#endif
 #include "hardware.h"
 #include "timer.h"
+#ifdef UART_CAPTURE
+#include "uart.h"
+#endif
 
 static unsigned char buf [32];
 static xbee_receive_type recv = { buf_ptr: buf, buf_size: sizeof buf };
 static xbee_request_type req;
+static xbee_identity_type identity;
+
+/* Time limit for a single radio operation, in clock ticks */
+#ifdef XBEE_POWER
+/* A request may be held while the radio sleeps */
+#define request_ticks (XBEE_POWER_PERIOD + 100)
+#else
+#define request_ticks 100
+#endif
 
 static void do_power_down (void) {
     buzzer_enable ();
@@ -38,14 +54,14 @@ static void do_power_down (void) {
 void test () {
     int r;
 
-    req.req = xbee_request_at;
-    req.args.at.cmd [0] = 'F';
-    req.args.at.cmd [1] = 'R';
-    req.args.at.data_size = 0;
-    req.args.at.buf_size = 0;
-    SynthOS_call (xbee_request (&req));
-    if (req.args.at.status != 0)
+    r = SynthOS_call (xbee_warm_start (&identity));
+    if (r == xbee_timeout) {
+#ifdef UART_CAPTURE
+        /* What the line carried, for host/replay.c */
+        uart_capture_dump (0);
+#endif
         do_power_down ();
+    }
     for (;;) {
         SynthOS_wait (associated);
         led_enable ();
@@ -59,7 +75,7 @@ void test () {
             req.args.transmit.addr = recv.addr;
             req.args.transmit.data_ptr = buf;
             req.args.transmit.data_size = recv.recv_size;
-            SynthOS_call (xbee_request (&req));
+            SynthOS_call (xbee_request_timed (&req, request_ticks));
         }
         led_disable ();
     }
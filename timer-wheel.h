@@ -0,0 +1,81 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Timer wheel shared by the timer modules
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Included once, by the timer module of the port (timer.c, or
+ * host/timer-posix.c). The port supplies the clock tick and the lock:
+ * every function here is called with interrupts masked.
+ *
+ * Include after timer.h.
+ */
+#include <stddef.h>
+
+#if (TIMER_WHEEL_SIZE & (TIMER_WHEEL_SIZE - 1)) != 0
+#error "TIMER_WHEEL_SIZE must be a power of 2"
+#endif
+
+/* Armed timers by clock value to fire at, modulo TIMER_WHEEL_SIZE */
+static timer_type * timer_wheel [TIMER_WHEEL_SIZE];
+
+static void timer_unlink (timer_type * t) {
+    if (t->next != NULL)
+        t->next->pprev = t->pprev;
+    *t->pprev = t->next;
+    t->pprev = NULL;
+}
+
+/* Fires the timers of the tick clock has just reached */
+static void timer_wheel_tick (void) {
+    timer_type * t, * next;
+
+    /* Timers of the later rounds stay in the slot */
+    for (t = timer_wheel [clock & (TIMER_WHEEL_SIZE - 1)]; t != NULL; t = next) {
+        next = t->next;
+        if (t->expires == clock) {
+            timer_unlink (t);
+            t->fired = 1;
+        }
+    }
+}
+
+/* See timer_arm */
+static void timer_wheel_arm (timer_type * t, unsigned ticks) {
+    timer_type ** slot;
+
+    t->pprev = NULL;
+    if (ticks == 0)
+        t->fired = 1;
+    else {
+        t->fired = 0;
+        t->expires = clock + ticks;
+        slot = &timer_wheel [t->expires & (TIMER_WHEEL_SIZE - 1)];
+        t->next = *slot;
+        if (t->next != NULL)
+            t->next->pprev = &t->next;
+        t->pprev = slot;
+        *slot = t;
+    }
+}
+
+/* See timer_cancel */
+static void timer_wheel_cancel (timer_type * t) {
+    if (t->pprev != NULL)
+        timer_unlink (t);
+}
@@ -22,12 +22,18 @@
 #include <avr/interrupt.h>
 
 #include "timer.h"
+#include "timer-wheel.h"
+#include "synthos-support.h"
 
 volatile unsigned clock;
 
+/* Number of times clock wrapped around */
+static volatile unsigned clock_high;
+
 static void timer_init (void) __attribute__ ((constructor));
 static void timer_init (void) {
     clock = 0;
+    clock_high = 0;
 
     TCCR2A = _BV (WGM21);
     TCCR2B = _BV (CS22) | _BV (CS21) | _BV (CS20);
@@ -38,7 +44,11 @@ static void timer_init (void) {
 
 /* Timer interrupt */
 ISR (TIMER2_COMPA_vect) {
-    clock ++;
+    interrupt_count ++;
+    if (++ clock == 0)
+        clock_high ++;
+
+    timer_wheel_tick ();
 }
 
 /**
@@ -98,3 +108,89 @@ unsigned pdiff (unsigned start, unsigned end) {
     }
     return (unsigned) dh * clock_divider + dl;
 }
+
+/**
+ * @brief  Reports 64us resolution clock that does not wrap around for days.
+ *
+ * Wrap around time: 0.000064000 * 2^32 / 3600 = 76.354974 (~76 hours).
+ * Use with ldiff and lafter.
+ *
+ * @return  number of time units (64us each) since start, modulo 2^32
+ */
+uint32_t lclock (void) {
+    uint8_t sreg = SREG;
+    uint32_t ticks;
+    unsigned char r;
+
+    cli ();
+
+    r = TCNT2;
+    ticks = ((uint32_t) clock_high << 16) | clock;
+
+    /* See pclock */
+    if ((TIFR2 & _BV (OCF2A)) != 0) {
+        ticks ++;
+        r = 0;
+    }
+
+    SREG = sreg;
+
+    /* Wraps around in step with ticks since the product is taken modulo 2^32 */
+    return ticks * clock_divider + r;
+}
+
+/**
+ * @brief Calculates time period
+ * @param  start  start of period (lclock)
+ * @param  end    end of period (lclock)
+ * @return  number of time units (64us each)
+ */
+uint32_t ldiff (uint32_t start, uint32_t end) {
+    return end - start;
+}
+
+/**
+ * @brief Compares two points in time
+ *
+ * Gives the right answer as long as they are less than ~38 hours apart.
+ *
+ * @param  a  one point (lclock)
+ * @param  b  another point (lclock)
+ * @return  nonzero if a is later than b
+ */
+int lafter (uint32_t a, uint32_t b) {
+    return (int32_t) (a - b) > 0;
+}
+
+/**
+ * @brief  Arms a timer
+ *
+ * "fired" is cleared and gets set after the given number of ticks,
+ * counting the current (partial) one, as with "clock - start >= ticks".
+ * The timer must not be armed already.
+ *
+ * @param  t  the timer, must stay in place until it fires or is cancelled
+ * @param  ticks  time in clock ticks (~10ms each), 0 fires at once
+ */
+void timer_arm (timer_type * t, unsigned ticks) {
+    uint8_t sreg = SREG;
+
+    cli ();
+    timer_wheel_arm (t, ticks);
+    SREG = sreg;
+}
+
+/**
+ * @brief  Cancels a timer, if it is armed
+ *
+ * "fired" is left as it is.
+ *
+ * @param  t  the timer
+ */
+void timer_cancel (timer_type * t) {
+    uint8_t sreg = SREG;
+
+    cli ();
+    timer_wheel_cancel (t);
+    SREG = sreg;
+}
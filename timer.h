@@ -24,11 +24,51 @@
  * + Internal clock register span:  0-155
  * + Clock tick time:  0.000064000 * 156 = 0.009984000 (~10ms)
  * + Clock wrap around time:  0.009984000 * 65536 / 60 = 10.905190400 (~11 min)
+ * + Long clock wrap around time:  0.000064000 * 2^32 / 3600 = 76.354974 (~76 hours)
+ *
+ * Subtracting two clock readings gives the right number of ticks as long
+ * as the period is shorter than the wrap around time. For longer periods
+ * and for anything finer than a tick, use lclock with ldiff/lafter.
+ *
+ * Timers (timer_type) are kept in a hashed wheel of TIMER_WHEEL_SIZE
+ * slots, by the tick they expire on. The clock interrupt looks only
+ * at the slot of the current tick, so its cost depends on the number
+ * of timers in that slot rather than on the number of timers armed.
+ * A task waits for "fired" instead of watching clock:
+ *
+ *     timer_arm (&t, ticks);
+ *     SynthOS_wait (something_happened || t.fired);
+ *     timer_cancel (&t);
  */
+#include <stdint.h>
+
 #define clock_divider 156
 #define time_step 0.000064L
 
+/* Power of 2 */
+#ifndef TIMER_WHEEL_SIZE
+#define TIMER_WHEEL_SIZE 8
+#endif
+
+/**
+ * @brief  Timer (see @ref timer_arm)
+ *
+ * Zero-initialized or cancelled timers are not armed.
+ */
+typedef struct timer {
+    struct timer * next, ** pprev; /* pprev == NULL - not armed */
+    unsigned expires;              /* clock value to fire at */
+    volatile unsigned char fired;
+} timer_type;
+
 extern volatile unsigned clock;
 
 unsigned pclock (void);
 unsigned pdiff (unsigned start, unsigned end);
+
+uint32_t lclock (void);
+uint32_t ldiff (uint32_t start, uint32_t end);
+int lafter (uint32_t a, uint32_t b);
+
+void timer_arm (timer_type * t, unsigned ticks);
+void timer_cancel (timer_type * t);
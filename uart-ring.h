@@ -0,0 +1,169 @@
+/**
+ * @addtogroup    XBeeTest
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         UART rings and capture shared by the UART modules
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Included once, by the UART module of the port (uart.c, or
+ * host/uart-posix.c), which moves the bytes between the rings and
+ * the line. The functions marked "called from interrupt" run in the
+ * port's interrupt handlers; uart_capture_take is called with
+ * interrupts masked. The rest take no lock: every ring index has
+ * a single writer.
+ *
+ * Include after uart.h, and timer.h for the capture.
+ */
+
+#ifdef UART_TX_RING_SIZE
+#if (UART_TX_RING_SIZE & (UART_TX_RING_SIZE - 1)) != 0 || UART_TX_RING_SIZE > 256
+#error UART_TX_RING_SIZE must be a power of 2 not exceeding 256
+#endif
+
+#define UART_TX_RING_MASK (UART_TX_RING_SIZE - 1)
+
+/* The head is moved by the task, the tail is moved by the interrupt */
+static volatile unsigned char uart_tx_ring [UART_PORTS] [UART_TX_RING_SIZE];
+static volatile unsigned char uart_tx_head [UART_PORTS], uart_tx_tail [UART_PORTS];
+
+unsigned uart_tx_space (int port) {
+    return UART_TX_RING_MASK - ((uart_tx_head [port] - uart_tx_tail [port]) & UART_TX_RING_MASK);
+}
+
+void uart_tx_put (int port, unsigned char byte) {
+    unsigned char head = uart_tx_head [port];
+
+    uart_tx_ring [port] [head] = byte;
+    uart_tx_head [port] = (head + 1) & UART_TX_RING_MASK;
+}
+
+/* Called from interrupt. Returns the next byte to send, -1 if the ring is empty */
+static inline int uart_tx_take (int port) {
+    unsigned char tail = uart_tx_tail [port];
+    unsigned char byte;
+
+    if (tail == uart_tx_head [port])
+        return -1;
+    byte = uart_tx_ring [port] [tail];
+    uart_tx_tail [port] = (tail + 1) & UART_TX_RING_MASK;
+    return byte;
+}
+#endif
+
+#ifdef UART_RX_RING_SIZE
+#if (UART_RX_RING_SIZE & (UART_RX_RING_SIZE - 1)) != 0 || UART_RX_RING_SIZE > 256
+#error UART_RX_RING_SIZE must be a power of 2 not exceeding 256
+#endif
+
+#define UART_RX_RING_MASK (UART_RX_RING_SIZE - 1)
+
+/* The head is moved by the interrupt, the tail is moved by the task */
+static volatile unsigned char uart_rx_ring [UART_PORTS] [UART_RX_RING_SIZE];
+static volatile unsigned char uart_rx_head [UART_PORTS], uart_rx_tail [UART_PORTS];
+
+volatile unsigned uart_rx_overruns [UART_PORTS], uart_rx_frame_errors [UART_PORTS], uart_rx_dropped [UART_PORTS];
+
+unsigned uart_rx_count (int port) {
+    return (uart_rx_head [port] - uart_rx_tail [port]) & UART_RX_RING_MASK;
+}
+
+/* Returns the oldest byte received, -1 if the ring is empty */
+static inline int uart_rx_take (int port) {
+    unsigned char tail = uart_rx_tail [port];
+    unsigned char byte;
+
+    if (tail == uart_rx_head [port])
+        return -1;
+    byte = uart_rx_ring [port] [tail];
+    uart_rx_tail [port] = (tail + 1) & UART_RX_RING_MASK;
+    return byte;
+}
+
+/* Called from interrupt */
+static inline void uart_rx_put (int port, unsigned char byte) {
+    unsigned char head = uart_rx_head [port];
+    unsigned char next = (head + 1) & UART_RX_RING_MASK;
+
+    if (next == uart_rx_tail [port]) {
+        uart_rx_dropped [port] ++;
+        return;
+    }
+    uart_rx_ring [port] [head] = byte;
+    uart_rx_head [port] = next;
+}
+#endif
+
+#ifdef UART_CAPTURE
+#if (UART_CAPTURE & (UART_CAPTURE - 1)) != 0 || UART_CAPTURE > 256
+#error UART_CAPTURE must be a power of 2 not exceeding 256
+#endif
+
+#define UART_CAPTURE_MASK (UART_CAPTURE - 1)
+
+/* The head is moved by the interrupts, the tail by both sides when the ring is full */
+static volatile uart_capture_type uart_capture_ring [UART_CAPTURE];
+static volatile unsigned char uart_capture_head, uart_capture_tail;
+/* lclock () of the last entry */
+static uint32_t uart_capture_last;
+
+volatile unsigned char uart_capture_on = 1;
+volatile unsigned uart_capture_lost;
+
+/* Called from interrupt */
+static inline void uart_capture_put (unsigned char flags, uint16_t time, unsigned char byte) {
+    unsigned char head = uart_capture_head;
+    unsigned char next = (head + 1) & UART_CAPTURE_MASK;
+
+    if (next == uart_capture_tail) {
+        /* Keep the latest */
+        uart_capture_tail = (next + 1) & UART_CAPTURE_MASK;
+        uart_capture_lost ++;
+    }
+    uart_capture_ring [head].time = time;
+    uart_capture_ring [head].flags = flags;
+    uart_capture_ring [head].byte = byte;
+    uart_capture_head = next;
+}
+
+/* Called from interrupt */
+static inline void uart_capture (int port, unsigned char flags, unsigned char byte) {
+    uint32_t now, delta;
+
+    if (!uart_capture_on)
+        return;
+    now = lclock ();
+    delta = ldiff (uart_capture_last, now);
+    uart_capture_last = now;
+    /* More than ~4 sec since the last entry */
+    if (delta > 0xFFFF)
+        uart_capture_put (UART_CAPTURE_GAP | (unsigned char) port, (uint16_t) (delta >> 16), 0);
+    uart_capture_put (flags | (unsigned char) port, (uint16_t) delta, byte);
+}
+
+/* See uart_capture_get */
+static int uart_capture_take (uart_capture_type * entry) {
+    unsigned char tail = uart_capture_tail;
+
+    if (tail == uart_capture_head)
+        return 0;
+    entry->time = uart_capture_ring [tail].time;
+    entry->flags = uart_capture_ring [tail].flags;
+    entry->byte = uart_capture_ring [tail].byte;
+    uart_capture_tail = (tail + 1) & UART_CAPTURE_MASK;
+    return 1;
+}
+#endif
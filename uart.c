@@ -22,35 +22,421 @@
 #include <avr/interrupt.h>
 
 #include "uart.h"
+#include "synthos-support.h"
+#ifdef UART_CAPTURE
+#include "timer.h"
+#endif
+#include "uart-ring.h"
 
-#define UART_PRESCALLER  (unsigned) (((F_CPU / (UART_BAUDRATE * 8UL))) - 1)
+/* Divisor with U2X0 set, rounded to the nearest */
+#define UART_DIVISOR(rate)  (((F_CPU + (rate) * 4UL) / ((rate) * 8UL)) - 1)
+#define UART_ACTUAL(rate)   (F_CPU / ((UART_DIVISOR (rate) + 1) * 8UL))
+#define UART_PRESCALLER     (unsigned) UART_DIVISOR (UART_BAUDRATE)
+
+#if (UART_ACTUAL (UART_BAUDRATE) > UART_BAUDRATE ? \
+     UART_ACTUAL (UART_BAUDRATE) - UART_BAUDRATE : UART_BAUDRATE - UART_ACTUAL (UART_BAUDRATE)) \
+    * 1000UL > UART_BAUDRATE * UART_BAUD_TOLERANCE
+#error UART_BAUDRATE cannot be generated from F_CPU within UART_BAUD_TOLERANCE
+#endif
+
+#if UART_PORTS < 1 || UART_PORTS > 4
+#error UART_PORTS must be from 1 to 4
+#endif
+
+#if UART_PORTS > 1 && (defined (UART_CTS) || defined (UART_RTS))
+#error UART_CTS and UART_RTS support a single port
+#endif
+
+/* Registers of a port. The bits are at the same places in all of them. */
+typedef struct {
+    volatile uint8_t * ucsra;
+    volatile uint8_t * ucsrb;
+    volatile uint8_t * ucsrc;
+    volatile uint8_t * ubrrh;
+    volatile uint8_t * ubrrl;
+    volatile uint8_t * udr;
+} uart_port_type;
+
+static const uart_port_type uart_ports [UART_PORTS] = {
+    { &UCSR0A, &UCSR0B, &UCSR0C, &UBRR0H, &UBRR0L, &UDR0 },
+#if UART_PORTS > 1
+    { &UCSR1A, &UCSR1B, &UCSR1C, &UBRR1H, &UBRR1L, &UDR1 },
+#endif
+#if UART_PORTS > 2
+    { &UCSR2A, &UCSR2B, &UCSR2C, &UBRR2H, &UBRR2L, &UDR2 },
+#endif
+#if UART_PORTS > 3
+    { &UCSR3A, &UCSR3B, &UCSR3C, &UBRR3H, &UBRR3L, &UDR3 },
+#endif
+};
+
+/* Parts with several USARTs number the vectors of USART0 too */
+#ifdef USART0_RX_vect
+#define UART_RX_VECT_0      USART0_RX_vect
+#define UART_UDRE_VECT_0    USART0_UDRE_vect
+#else
+#define UART_RX_VECT_0      USART_RX_vect
+#define UART_UDRE_VECT_0    USART_UDRE_vect
+#endif
+
+#ifdef UART_RTS
+#ifndef UART_RX_RING_SIZE
+#error UART_RTS needs UART_RX_RING_SIZE
+#endif
+#ifndef UART_RTS_BIT
+#define UART_RTS_BIT 5 /* PD5 */
+#endif
+/* RTS is deasserted when the receive ring gets that full ... */
+#ifndef UART_RTS_HIGH
+#define UART_RTS_HIGH (UART_RX_RING_SIZE * 3 / 4)
+#endif
+/* ... and asserted again when it drains to that level */
+#ifndef UART_RTS_LOW
+#define UART_RTS_LOW (UART_RX_RING_SIZE / 4)
+#endif
+#endif
+
+#ifdef UART_CTS
+#ifndef UART_CTS_BIT
+#define UART_CTS_BIT 4 /* PD4, PCINT20 */
+#endif
+#endif
+
+#if defined (UART_CTS) || defined (UART_XON_XOFF)
+#define UART_TX_FLOW_CONTROL
+/* There is something to send */
+static volatile unsigned char uart_tx_active [UART_PORTS];
+/* The radio sent XOFF */
+static volatile unsigned char uart_tx_xoff [UART_PORTS];
+#endif
+
+#ifdef UART_CAPTURE
+/**
+ * @brief  Takes the oldest entry from the capture ring
+ * @param  [out] entry  the entry
+ * @return  nonzero if an entry was taken, 0 if the ring is empty
+ */
+int uart_capture_get (uart_capture_type * entry) {
+    uint8_t sreg = SREG;
+    int r;
+
+    cli ();
+    r = uart_capture_take (entry);
+    SREG = sreg;
+    return r;
+}
+
+static void uart_dump_byte (int port, unsigned char byte) {
+    while (!(*uart_ports [port].ucsra & _BV (UDRE0)))
+        ;
+    *uart_ports [port].udr = byte;
+}
+
+/**
+ * @brief  Sends the capture ring out of a port
+ *
+ * Freezes the capture and writes the entries to the port the way
+ * host/replay.c reads them: time (high byte first), flags, byte.
+ * The data register is polled; the driver does not send on the port
+ * until the dump is over. Takes ~90 ms for 256 entries at 115200.
+ *
+ * @param  port  UART port
+ */
+void uart_capture_dump (int port) {
+    volatile uint8_t * ucsrb = uart_ports [port].ucsrb;
+    uart_capture_type entry;
+    uint8_t sreg = SREG;
+    unsigned char udrie;
+
+    uart_capture_on = 0;
+
+    cli ();
+    udrie = *ucsrb & _BV (UDRIE0);
+    *ucsrb &= ~_BV (UDRIE0);
+    SREG = sreg;
+
+    while (uart_capture_get (&entry)) {
+        uart_dump_byte (port, (unsigned char) (entry.time >> 8));
+        uart_dump_byte (port, (unsigned char) entry.time);
+        uart_dump_byte (port, entry.flags);
+        uart_dump_byte (port, entry.byte);
+    }
+
+    cli ();
+    *ucsrb |= udrie;
+    SREG = sreg;
+}
+#endif
+
+uint32_t uart_baudrate [UART_PORTS];
 
 /**
  * @brief UART initialization routine
  */
 static void uart_init (void) __attribute__ ((constructor));
 static void uart_init (void) {
-    UCSR0B = _BV (TXEN0) | _BV (RXEN0) | _BV (RXCIE0);
-    UCSR0A |= _BV (U2X0);
-    UCSR0C = _BV (UCSZ00) | _BV (UCSZ01);
-    UBRR0H = (uint8_t) (UART_PRESCALLER >> 8);
-    UBRR0L = (uint8_t) UART_PRESCALLER;
+    const uart_port_type * p;
+    int port;
+
+    for (port = 0; port < UART_PORTS; port ++) {
+        p = &uart_ports [port];
+        *p->ucsrb = _BV (TXEN0) | _BV (RXEN0) | _BV (RXCIE0);
+        *p->ucsra |= _BV (U2X0);
+        *p->ucsrc = _BV (UCSZ00) | _BV (UCSZ01);
+        *p->ubrrh = (uint8_t) (UART_PRESCALLER >> 8);
+        *p->ubrrl = (uint8_t) UART_PRESCALLER;
+        uart_baudrate [port] = UART_BAUDRATE;
+    }
+#ifdef UART_RTS
+    /* Output, asserted (low) */
+    PORTD &= ~_BV (UART_RTS_BIT);
+    DDRD |= _BV (UART_RTS_BIT);
+#endif
+#ifdef UART_CTS
+    /* Input, a change resumes the transmission */
+    DDRD &= ~_BV (UART_CTS_BIT);
+    PCMSK2 |= _BV (UART_CTS_BIT);
+    PCICR |= _BV (PCIE2);
+#endif
+}
+
+/**
+ * @brief  Reports the error of a baud rate generated from F_CPU
+ * @param  rate  baud rate
+ * @return  error in per mille
+ */
+unsigned uart_baudrate_error (uint32_t rate) {
+    uint32_t actual = F_CPU / ((UART_DIVISOR (rate) + 1) * 8UL);
+    uint32_t diff = actual > rate ? actual - rate : rate - actual;
+
+    return (unsigned) (diff * 1000UL / rate);
+}
+
+/**
+ * @brief  Changes the baud rate
+ *
+ * The transmitter has to be idle: nothing must be in the middle of sending.
+ *
+ * @param  port  UART port
+ * @param  rate  baud rate
+ */
+void uart_set_baudrate (int port, uint32_t rate) {
+    unsigned divisor = (unsigned) UART_DIVISOR (rate);
+
+    *uart_ports [port].ubrrh = (uint8_t) (divisor >> 8);
+    *uart_ports [port].ubrrl = (uint8_t) divisor;
+    uart_baudrate [port] = rate;
+}
+
+#ifdef UART_TX_FLOW_CONTROL
+/* The radio cannot take more data */
+static int uart_tx_stopped (int port) {
+#ifdef UART_CTS
+    /* CTS is active low */
+    if (PIND & _BV (UART_CTS_BIT))
+        return 1;
+#endif
+#ifdef UART_XON_XOFF
+    if (uart_tx_xoff [port])
+        return 1;
+#endif
+    return 0;
+}
+
+/* Called from interrupt when the radio may be ready again */
+static void uart_tx_resume (int port) {
+    if (uart_tx_active [port] && !uart_tx_stopped (port))
+        *uart_ports [port].ucsrb |= _BV (UDRIE0);
+}
+#endif
+
+#ifdef UART_CTS
+ISR (PCINT2_vect) {
+    interrupt_count ++;
+    uart_tx_resume (0);
 }
+#endif
 
-/** @brief Activates UART transmission by enable "register empty" interrupt */
-void uart_transmit (void) {
-    UCSR0B |= _BV (UDRIE0);
+/**
+ * @brief Activates UART transmission by enable "register empty" interrupt
+ * @param  port  UART port
+ */
+void uart_transmit (int port) {
+#ifdef UART_TX_FLOW_CONTROL
+    uart_tx_active [port] = 1;
+#endif
+    *uart_ports [port].ucsrb |= _BV (UDRIE0);
 }
 
-ISR (USART_UDRE_vect) {
-    int x = uart_transmit_byte ();
+/*
+ * The interrupt handlers below are shared by the ports. Each vector
+ * calls them with a constant port number, so they get inlined with
+ * the register addresses known.
+ */
+
+#ifdef UART_TX_RING_SIZE
+static inline void uart_udre_interrupt (int port) {
+    int x;
+
+#ifdef UART_TX_FLOW_CONTROL
+    if (uart_tx_stopped (port)) {
+        /* Resumed by uart_tx_resume */
+        *uart_ports [port].ucsrb &= ~_BV (UDRIE0);
+        return;
+    }
+#endif
+    x = uart_tx_take (port);
     if (x != -1) {
-        UDR0 = (unsigned char) x;
+        *uart_ports [port].udr = (unsigned char) x;
+#ifdef UART_CAPTURE
+        uart_capture (port, UART_CAPTURE_TX, (unsigned char) x);
+#endif
         return;
     }
-    UCSR0B &= ~_BV (UDRIE0);
+#ifdef UART_TX_FLOW_CONTROL
+    uart_tx_active [port] = 0;
+#endif
+    *uart_ports [port].ucsrb &= ~_BV (UDRIE0);
+}
+#else
+static inline void uart_udre_interrupt (int port) {
+    int x;
+
+#ifdef UART_TX_FLOW_CONTROL
+    if (uart_tx_stopped (port)) {
+        /* Resumed by uart_tx_resume */
+        *uart_ports [port].ucsrb &= ~_BV (UDRIE0);
+        return;
+    }
+#endif
+    x = uart_transmit_byte (port);
+    if (x != -1) {
+        *uart_ports [port].udr = (unsigned char) x;
+#ifdef UART_CAPTURE
+        uart_capture (port, UART_CAPTURE_TX, (unsigned char) x);
+#endif
+        return;
+    }
+#ifdef UART_TX_FLOW_CONTROL
+    uart_tx_active [port] = 0;
+#endif
+    *uart_ports [port].ucsrb &= ~_BV (UDRIE0);
+}
+#endif
+
+#ifdef UART_XON_XOFF
+/*
+ * Called from interrupt. In API mode 2, 0x11 and 0x13 in the data are
+ * escaped, so any of them on the line is a flow control character.
+ * Returns nonzero if the byte was consumed.
+ */
+static int uart_rx_flow (int port, unsigned char byte) {
+    switch (byte) {
+      case 0x13: /* XOFF */
+        uart_tx_xoff [port] = 1;
+        return 1;
+      case 0x11: /* XON */
+        uart_tx_xoff [port] = 0;
+        uart_tx_resume (port);
+        return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef UART_RX_RING_SIZE
+int uart_rx_get (int port) {
+    int byte = uart_rx_take (port);
+
+#ifdef UART_RTS
+    /* A single bit operation, safe against the interrupt */
+    if (byte != -1 && uart_rx_count (port) <= UART_RTS_LOW)
+        PORTD &= ~_BV (UART_RTS_BIT);
+#endif
+    return byte;
+}
+
+static inline void uart_rx_interrupt (int port) {
+    /* The status has to be read before the data */
+    unsigned char status = *uart_ports [port].ucsra;
+    unsigned char byte = *uart_ports [port].udr;
+
+    if (status & _BV (DOR0))
+        uart_rx_overruns [port] ++;
+    if (status & _BV (FE0))
+        uart_rx_frame_errors [port] ++;
+#ifdef UART_CAPTURE
+    uart_capture (port,
+      (status & _BV (DOR0) ? UART_CAPTURE_OVERRUN : 0) | (status & _BV (FE0) ? UART_CAPTURE_FRAME_ERROR : 0),
+      byte);
+#endif
+#ifdef UART_XON_XOFF
+    if (uart_rx_flow (port, byte))
+        return;
+#endif
+    uart_rx_put (port, byte);
+#ifdef UART_RTS
+    if (uart_rx_count (port) >= UART_RTS_HIGH)
+        PORTD |= _BV (UART_RTS_BIT);
+#endif
+}
+#else
+static inline void uart_rx_interrupt (int port) {
+    unsigned char byte = *uart_ports [port].udr;
+
+#ifdef UART_CAPTURE
+    uart_capture (port, 0, byte);
+#endif
+#ifdef UART_XON_XOFF
+    if (uart_rx_flow (port, byte))
+        return;
+#endif
+    uart_receive_byte (port, byte);
+}
+#endif
+
+ISR (UART_RX_VECT_0) {
+    interrupt_count ++;
+    uart_rx_interrupt (0);
+}
+
+ISR (UART_UDRE_VECT_0) {
+    interrupt_count ++;
+    uart_udre_interrupt (0);
+}
+
+#if UART_PORTS > 1
+ISR (USART1_RX_vect) {
+    interrupt_count ++;
+    uart_rx_interrupt (1);
+}
+
+ISR (USART1_UDRE_vect) {
+    interrupt_count ++;
+    uart_udre_interrupt (1);
+}
+#endif
+
+#if UART_PORTS > 2
+ISR (USART2_RX_vect) {
+    interrupt_count ++;
+    uart_rx_interrupt (2);
+}
+
+ISR (USART2_UDRE_vect) {
+    interrupt_count ++;
+    uart_udre_interrupt (2);
+}
+#endif
+
+#if UART_PORTS > 3
+ISR (USART3_RX_vect) {
+    interrupt_count ++;
+    uart_rx_interrupt (3);
 }
 
-ISR (USART_RX_vect) {
-    uart_receive_byte (UDR0);
+ISR (USART3_UDRE_vect) {
+    interrupt_count ++;
+    uart_udre_interrupt (3);
 }
+#endif
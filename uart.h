@@ -25,27 +25,155 @@
  * we check the corresponding condition explicitly after SynthOS_wait
  * as there is no guarantee that they are still met when the scheduler
  * gives control back to us.
+ *
+ * If UART_TX_RING_SIZE is defined (a power of 2, up to 256), the whole
+ * frame is prepared in task context and put to the transmit ring with
+ * uart_tx_put. The "register empty" interrupt only moves the bytes from
+ * the ring to the data register.
+ *
+ * If UART_RX_RING_SIZE is defined (a power of 2, up to 256), the "receive
+ * complete" interrupt only puts the received bytes to the receive ring and
+ * counts hardware errors. The bytes are taken from the ring with
+ * uart_rx_get and decoded in task context.
+ *
+ * Flow control (all optional):
+ *   UART_CTS - transmission pauses while the radio deasserts CTS
+ *              (pin UART_CTS_BIT of port D, default PD4; XBee D7=1);
+ *   UART_RTS - RTS is deasserted when the receive ring is UART_RTS_HIGH
+ *              full and asserted again at UART_RTS_LOW (pin UART_RTS_BIT
+ *              of port D, default PD5; XBee D6=1). Needs UART_RX_RING_SIZE;
+ *   UART_XON_XOFF - transmission pauses between XOFF and XON sent by
+ *              the radio.
+ *
+ * UART_PORTS (1 to 4, default 1) ports are driven, USART0 to USART3
+ * on parts that have them (e.g. ATmega2560). Every function takes the
+ * port number. UART_CTS and UART_RTS work with a single port only.
+ *
+ * If UART_CAPTURE is defined (a power of 2, up to 256), every byte
+ * received or sent by the interrupt handlers is recorded in a ring of
+ * that many entries; the oldest ones are overwritten. The time of an
+ * entry is lclock () units since the previous one; a longer pause than
+ * 16 bits hold is put ahead as an UART_CAPTURE_GAP entry with the high
+ * 16 bits. Clearing uart_capture_on freezes the ring, e.g. when the
+ * driver starts dropping frames, so that it can be taken out with
+ * uart_capture_get. uart_capture_dump sends it out of a port as
+ * 4 bytes an entry: time (high byte first), flags, byte, to be
+ * replayed on the host (host/replay.c).
  */
+#include <stdint.h>
+
+#ifndef UART_PORTS
+#define UART_PORTS                1
+#endif
+
 #ifndef UART_BAUDRATE
 #define UART_BAUDRATE             115200
 #endif
 
-void uart_transmit (void);
+/* Largest acceptable baud rate error, per mille (115200 at 16MHz is 2.1%) */
+#ifndef UART_BAUD_TOLERANCE
+#define UART_BAUD_TOLERANCE       25
+#endif
+
+/** @brief Current baud rate of every port */
+extern uint32_t uart_baudrate [UART_PORTS];
+
+unsigned uart_baudrate_error (uint32_t rate);
+void uart_set_baudrate (int port, uint32_t rate);
+
+void uart_transmit (int port);
+
+#ifdef UART_TX_RING_SIZE
+/**
+ * @brief  Reports free space in the transmit ring
+ * @param  port  UART port
+ * @return number of bytes that can be put to the ring
+ */
+unsigned uart_tx_space (int port);
+
+/**
+ * @brief  Puts a byte to the transmit ring
+ *
+ * The caller has to make sure there is free space in the ring
+ * (see @ref uart_tx_space). Call @ref uart_transmit to start sending.
+ *
+ * @param  port  UART port
+ * @param  byte byte of data
+ */
+void uart_tx_put (int port, unsigned char byte);
+#endif
+
+#ifdef UART_RX_RING_SIZE
+/** @brief Number of data overrun errors (DOR0) of every port */
+extern volatile unsigned uart_rx_overruns [UART_PORTS];
+/** @brief Number of frame errors (FE0) of every port */
+extern volatile unsigned uart_rx_frame_errors [UART_PORTS];
+/** @brief Number of bytes dropped because the receive ring was full, of every port */
+extern volatile unsigned uart_rx_dropped [UART_PORTS];
+
+/**
+ * @brief  Reports the number of bytes waiting in the receive ring
+ * @param  port  UART port
+ * @return number of bytes
+ */
+unsigned uart_rx_count (int port);
+
+/**
+ * @brief  Takes a byte from the receive ring
+ * @param  port  UART port
+ * @return a byte of data or -1 if the ring is empty
+ */
+int uart_rx_get (int port);
+#endif
+
+#ifdef UART_CAPTURE
+/* Capture entry flags: port number in the low bits */
+#define UART_CAPTURE_PORT         0x03
+#define UART_CAPTURE_TX           0x80 /* sent, otherwise received */
+#define UART_CAPTURE_OVERRUN      0x40 /* data overrun before the byte (UART_RX_RING_SIZE only) */
+#define UART_CAPTURE_FRAME_ERROR  0x20 /* frame error on the byte (UART_RX_RING_SIZE only) */
+#define UART_CAPTURE_GAP          0x10 /* no byte: time is the high 16 bits of the next entry's */
+
+/**
+ * @brief Capture entry (see @ref uart_capture_get)
+ * @param  time  lclock () units from the previous entry to when the byte
+ *               was received or put to the data register
+ * @param  flags  UART_CAPTURE_xxx
+ * @param  byte  the byte
+ */
+typedef struct uart_capture {
+    uint16_t time;
+    unsigned char flags;
+    unsigned char byte;
+} uart_capture_type;
+
+/** @brief Nonzero while bytes are recorded */
+extern volatile unsigned char uart_capture_on;
+/** @brief Number of entries overwritten before they were taken */
+extern volatile unsigned uart_capture_lost;
+
+int uart_capture_get (uart_capture_type * entry);
+void uart_capture_dump (int port);
+#endif
 
 /**
  * @brief  Callback function that provides data to transmit
  *
- * This function is called from interrupt. 
+ * This function is called from interrupt. If UART_TX_RING_SIZE is
+ * defined, it is not used by the UART driver.
  *
+ * @param  port  UART port
  * @return a byte of data or -1 to stop the transmission.
  */
-int uart_transmit_byte (void);
+int uart_transmit_byte (int port);
 
 /**
  * @brief  Callback function delivers received data
  *
- * This function is called from interrupt.
+ * This function is called from interrupt. If UART_RX_RING_SIZE is
+ * defined, it is not used by the UART driver.
  *
+ * @param  port  UART port
  * @param  byte received byte of data
  */
-void uart_receive_byte (unsigned char byte);
+void uart_receive_byte (int port, unsigned char byte);
@@ -0,0 +1,171 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Asynchronous transmit
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ */
+
+#include <string.h>
+
+#include "timer.h"
+#include "xbee.h"
+#include "xbee-async.h"
+
+typedef enum {
+    async_free,
+    async_queued,
+    async_sent
+} async_state_type;
+
+typedef struct {
+    xbee_request_type req;
+    timer_type timeout;
+    unsigned char handle;
+    unsigned char state;
+    unsigned char data [XBEE_ASYNC_SIZE];
+} async_slot_type;
+
+static async_slot_type async_slots [XBEE_ASYNC_SLOTS];
+
+/* Queued slots, in the order of submission */
+static unsigned char async_queue [XBEE_ASYNC_SLOTS];
+static unsigned char async_queue_head, async_queue_count;
+
+static xbee_completion_type async_ring [XBEE_ASYNC_RING];
+static unsigned async_ring_head, async_ring_tail;
+
+static unsigned char async_handle;
+
+static int async_ring_full (void) {
+    return async_ring_head - async_ring_tail >= XBEE_ASYNC_RING;
+}
+
+static int async_done (async_slot_type * slot) {
+    return slot->state == async_sent && (!slot->req.busy || slot->timeout.fired);
+}
+
+static int async_ready (void) {
+    int i;
+
+    if (async_queue_count != 0)
+        return 1;
+    if (async_ring_full ())
+        return 0;
+    for (i = 0; i < XBEE_ASYNC_SLOTS; i ++)
+        if (async_done (&async_slots [i]))
+            return 1;
+    return 0;
+}
+
+static void async_complete (async_slot_type * slot) {
+    xbee_completion_type * c;
+
+    timer_cancel (&slot->timeout);
+    if (slot->req.busy)
+        /* No status in time */
+        xbee_cancel (&slot->req);
+
+    c = &async_ring [async_ring_head & (XBEE_ASYNC_RING - 1)];
+    c->handle = slot->handle;
+    c->radio = slot->req.radio;
+    c->id = slot->req.args.transmit.id;
+    c->status = slot->req.args.transmit.status;
+    c->retries = slot->req.args.transmit.retries;
+    c->discovery = slot->req.args.transmit.discovery;
+    async_ring_head ++;
+
+    slot->state = async_free;
+}
+
+int xbee_submit (const struct xbee_request * req_ptr) {
+    async_slot_type * slot;
+    int i;
+
+    if (req_ptr->req != xbee_request_transmit || req_ptr->args.transmit.data_size > XBEE_ASYNC_SIZE)
+        return 0;
+
+    for (i = 0; i < XBEE_ASYNC_SLOTS; i ++)
+        if (async_slots [i].state == async_free)
+            break;
+    if (i == XBEE_ASYNC_SLOTS)
+        return 0;
+
+    slot = &async_slots [i];
+    slot->req = *req_ptr;
+    memcpy (slot->data, req_ptr->args.transmit.data_ptr, req_ptr->args.transmit.data_size);
+    slot->req.args.transmit.data_ptr = slot->data;
+    slot->req.busy = 0;
+    slot->req.args.transmit.id = 0;
+    slot->req.args.transmit.retries = 0;
+    slot->req.args.transmit.discovery = 0;
+
+    if (++ async_handle == 0)
+        async_handle = 1;
+    slot->handle = async_handle;
+    slot->state = async_queued;
+
+    async_queue [(async_queue_head + async_queue_count) % XBEE_ASYNC_SLOTS] = (unsigned char) i;
+    async_queue_count ++;
+
+    return slot->handle;
+}
+
+int xbee_get_completion (xbee_completion_type * c) {
+    if (async_ring_head == async_ring_tail)
+        return 0;
+    * c = async_ring [async_ring_tail & (XBEE_ASYNC_RING - 1)];
+    async_ring_tail ++;
+    return 1;
+}
+
+int xbee_async_pending (void) {
+    int i, n = 0;
+
+    for (i = 0; i < XBEE_ASYNC_SLOTS; i ++)
+        if (async_slots [i].state != async_free)
+            n ++;
+    return n;
+}
+
+/**
+ * @brief  Sends the submitted requests and posts their completions
+ *
+ * This is a loop task.
+ */
+void xbee_async (void) {
+    async_slot_type * slot;
+    int i;
+
+    SynthOS_wait (async_ready ());
+
+    /* Completions first: they free the slots */
+    for (i = 0; i < XBEE_ASYNC_SLOTS && !async_ring_full (); i ++)
+        if (async_done (&async_slots [i]))
+            async_complete (&async_slots [i]);
+
+    if (async_queue_count == 0)
+        return;
+
+    slot = &async_slots [async_queue [async_queue_head]];
+    async_queue_head = (async_queue_head + 1) % XBEE_ASYNC_SLOTS;
+    async_queue_count --;
+
+    /* Stays so if the request could not be started */
+    slot->req.args.transmit.status = xbee_status_timeout;
+    SynthOS_call (xbee_post (&slot->req));
+    slot->state = async_sent;
+    timer_arm (&slot->timeout, XBEE_ASYNC_TICKS);
+}
@@ -0,0 +1,100 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Asynchronous transmit interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * xbee_submit copies a transmit request into one of XBEE_ASYNC_SLOTS
+ * slots and returns a handle at once; it is a plain function, not a
+ * task. The xbee_async loop task sends the queued requests in order and
+ * posts a completion for each of them to a ring of XBEE_ASYNC_RING
+ * entries, which the application drains with xbee_get_completion when
+ * it likes. A slot is not reused before its completion is in the ring,
+ * so nothing is lost when the application is late: xbee_submit fails
+ * instead.
+ *
+ * A request that gets no status within XBEE_ASYNC_TICKS is completed
+ * with xbee_status_timeout.
+ *
+ * Include after xbee.h.
+ */
+#ifndef XBEE_ASYNC_SLOTS
+#define XBEE_ASYNC_SLOTS XBEE_MAX_PENDING
+#endif
+
+/* Largest payload xbee_submit takes */
+#ifndef XBEE_ASYNC_SIZE
+#define XBEE_ASYNC_SIZE XBEE_MAX_PAYLOAD
+#endif
+
+/* Must be a power of 2 */
+#ifndef XBEE_ASYNC_RING
+#define XBEE_ASYNC_RING 8
+#endif
+
+#if (XBEE_ASYNC_RING & (XBEE_ASYNC_RING - 1)) != 0 || XBEE_ASYNC_RING > 256
+#error XBEE_ASYNC_RING must be a power of 2, up to 256
+#endif
+
+/* Time limit for the status, in clock ticks */
+#ifndef XBEE_ASYNC_TICKS
+#define XBEE_ASYNC_TICKS 200
+#endif
+
+/**
+ * @brief  Completion of a submitted transmit (see @ref xbee_get_completion)
+ * @param  handle  handle returned by @ref xbee_submit
+ * @param  radio  radio the request was sent through
+ * @param  id  frame ID the request was sent with
+ * @param  status  delivery status (0 - success, xbee_status_timeout - no status)
+ * @param  retries  transmit retries
+ * @param  discovery  discovery status
+ */
+typedef struct xbee_completion {
+    unsigned char handle;
+    unsigned char radio;
+    unsigned char id;
+    unsigned char status;
+    unsigned char retries;
+    unsigned char discovery;
+} xbee_completion_type;
+
+/**
+ * @brief  Submits a transmit request without waiting
+ *
+ * Takes the same parameters as @c xbee_request_transmit. The request
+ * and the payload are copied, so both can be reused on return.
+ *
+ * @param  req_ptr  structure contatining input data
+ *                  (see @ref xbee_request_type)
+ * @return  handle (1 to 255), 0 if all slots are taken or the request
+ *          is not a transmit of up to XBEE_ASYNC_SIZE bytes
+ */
+int xbee_submit (const struct xbee_request * req_ptr);
+
+/**
+ * @brief  Takes the oldest completion from the ring
+ * @param  [out] c  completion
+ * @return  nonzero if a completion was taken, 0 if the ring is empty
+ */
+int xbee_get_completion (xbee_completion_type * c);
+
+/**
+ * @brief  Number of submitted requests without a completion in the ring
+ */
+int xbee_async_pending (void);
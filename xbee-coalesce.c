@@ -0,0 +1,147 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Coalescing of small transmits
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ */
+
+#include <string.h>
+
+#include "timer.h"
+#include "xbee.h"
+#include "xbee-coalesce.h"
+
+static unsigned char coalesce_buf [XBEE_COALESCE_SIZE];
+static uint16_t coalesce_size;
+static uint32_t coalesce_addr_hi, coalesce_addr_lo;
+static unsigned char coalesce_radio;
+static timer_type coalesce_timer; /* armed with the first payload */
+static int coalesce_flushing;
+static xbee_request_type coalesce_req;
+
+/* XBEE_COALESCE_AGE rounded up to clock ticks */
+#define coalesce_ticks ((XBEE_COALESCE_AGE + clock_divider - 1) / clock_divider)
+
+static uint16_t coalesce_limit (void) {
+    return xbee_max_payload < sizeof coalesce_buf ? xbee_max_payload : sizeof coalesce_buf;
+}
+
+/**
+ * @brief  Send the collected payloads now
+ */
+void xbee_coalesce_flush (void) {
+    SynthOS_wait (!coalesce_flushing);
+
+    if (coalesce_size == 0)
+        return;
+
+    coalesce_flushing = 1;
+
+    /* The previous frame may still wait for its status */
+    SynthOS_wait (!coalesce_req.busy);
+
+    coalesce_req.req = xbee_request_transmit;
+    coalesce_req.radio = coalesce_radio;
+    coalesce_req.args.transmit.addr_hi = coalesce_addr_hi;
+    coalesce_req.args.transmit.addr_lo = coalesce_addr_lo;
+    coalesce_req.args.transmit.addr = xbee_addr_unknown;
+    coalesce_req.args.transmit.data_ptr = coalesce_buf;
+    coalesce_req.args.transmit.data_size = coalesce_size;
+    SynthOS_call (xbee_post (&coalesce_req));
+
+    coalesce_size = 0;
+    timer_cancel (&coalesce_timer);
+    coalesce_flushing = 0;
+}
+
+/**
+ * @brief  Transmit a small payload as part of a coalesced frame
+ *
+ * Takes the same parameters as @c xbee_request_transmit. The payload is
+ * copied, so the buffer can be reused on return. Payloads that are too
+ * big for coalescing are sent at once, after the collected ones.
+ * The delivery status is not reported.
+ *
+ * @param  req_ptr  structure contatining input data
+ *                  (see @ref xbee_request_type)
+ */
+void xbee_coalesce (struct xbee_request * req_ptr) {
+    uint16_t size;
+
+    size = req_ptr->args.transmit.data_size;
+
+    if (size > 0xFF || size + 1 > coalesce_limit ()) {
+        /* Keep the order: what was collected goes first */
+        SynthOS_call (xbee_coalesce_flush ());
+        SynthOS_call (xbee_request (req_ptr));
+        return;
+    }
+
+    for (;;) {
+        SynthOS_wait (!coalesce_flushing);
+        if (
+          coalesce_size == 0 || (
+            coalesce_radio == req_ptr->radio &&
+            coalesce_addr_hi == req_ptr->args.transmit.addr_hi &&
+            coalesce_addr_lo == req_ptr->args.transmit.addr_lo &&
+            coalesce_size + 1 + size <= coalesce_limit ()
+          )
+        )
+            break;
+        SynthOS_call (xbee_coalesce_flush ());
+    }
+
+    if (coalesce_size == 0) {
+        coalesce_radio = req_ptr->radio;
+        coalesce_addr_hi = req_ptr->args.transmit.addr_hi;
+        coalesce_addr_lo = req_ptr->args.transmit.addr_lo;
+        timer_arm (&coalesce_timer, coalesce_ticks);
+    }
+    coalesce_buf [coalesce_size] = (unsigned char) size;
+    memcpy (coalesce_buf + coalesce_size + 1, req_ptr->args.transmit.data_ptr, size);
+    coalesce_size += size + 1;
+    req_ptr->args.transmit.status = 0;
+}
+
+/**
+ * @brief  Sends the collected payloads when the oldest of them gets too old
+ *
+ * This is a loop task.
+ */
+void xbee_coalescer (void) {
+    SynthOS_wait (coalesce_size != 0 && coalesce_timer.fired);
+
+    SynthOS_call (xbee_coalesce_flush ());
+}
+
+int xbee_split (
+  const void * buf, uint16_t size, uint16_t * offset,
+  const unsigned char ** msg, uint16_t * msg_size
+) {
+    const unsigned char * p = (const unsigned char *) buf;
+    uint16_t len;
+
+    if (*offset >= size)
+        return 0;
+    len = p [*offset];
+    if (*offset + 1 + len > size)
+        /* Broken frame */
+        return 0;
+    *msg = p + *offset + 1;
+    *msg_size = len;
+    *offset += len + 1;
+    return 1;
+}
@@ -0,0 +1,53 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Coalescing of small transmits interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Small payloads for the same recipient, sent through the same radio,
+ * are collected in one RF frame. Each of them is preceded by its length
+ * (1 byte). The frame is sent when the next payload does not fit (see
+ * xbee_max_payload), when the recipient or the radio changes, or when
+ * the oldest payload is XBEE_COALESCE_AGE old. The recipient takes the
+ * payloads apart with xbee_split.
+ * Both sides have to agree on using coalescing.
+ *
+ * Include after xbee.h.
+ */
+#ifndef XBEE_COALESCE_SIZE
+#define XBEE_COALESCE_SIZE XBEE_MAX_PAYLOAD
+#endif
+
+/* Age limit in lclock units (64us each), rounded up to clock ticks */
+#ifndef XBEE_COALESCE_AGE
+#define XBEE_COALESCE_AGE 156
+#endif
+
+/**
+ * @brief  Takes the next payload from a coalesced frame
+ * @param  buf  frame data
+ * @param  size  frame data size
+ * @param  [in,out] offset  position in the frame, 0 to start
+ * @param  [out] msg  payload pointer
+ * @param  [out] msg_size  payload size
+ * @return  nonzero if a payload was taken, 0 at the end of the frame
+ */
+int xbee_split (
+  const void * buf, uint16_t size, uint16_t * offset,
+  const unsigned char ** msg, uint16_t * msg_size
+);
@@ -0,0 +1,525 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee module configuration
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ *   Settings are never written (WR): after a power cycle the radio
+ *   comes back with its saved configuration, as does the driver.
+ *
+ *   Everything here works with radio 0, so XBEE_RADIOS has to be 1.
+ *
+ *   The identity cache in EEPROM is rewritten only when it changes
+ *   (eeprom_update_block), so a node that reboots often does not
+ *   wear it out.
+ */
+
+#include <stddef.h>
+
+#include <avr/eeprom.h>
+
+#include "uart.h"
+#include "timer.h"
+#include "synthos-support.h"
+#include "xbee.h"
+#include "xbee-config.h"
+
+#if XBEE_RADIOS > 1
+#error xbee-config.c supports a single radio
+#endif
+
+#define byte3(v) ((unsigned char) ((v) >> 24))
+#define byte2(v) ((unsigned char) ((v) >> 16))
+#define byte1(v) ((unsigned char) ((v) >>  8))
+#define byte0(v) ((unsigned char)  (v)       )
+
+/* Baud rates to try, slowest first. BD takes a code for the standard ones. */
+static const struct {
+    uint32_t rate;
+    uint32_t bd;
+} config_rates [] = {
+    {   1200UL, 0 },
+    {   2400UL, 1 },
+    {   4800UL, 2 },
+    {   9600UL, 3 },
+    {  19200UL, 4 },
+    {  38400UL, 5 },
+    {  57600UL, 6 },
+    { 115200UL, 7 },
+    { 230400UL, 230400UL },
+    { 250000UL, 250000UL },
+    { 500000UL, 500000UL },
+    { 1000000UL, 1000000UL }
+};
+
+/*
+ * The entry points share config_req and the batch state below, so they
+ * run one at a time: the others wait while config_busy is set.
+ */
+static int config_busy;
+
+static xbee_request_type config_req;
+static unsigned char config_data [4], config_buf [4];
+
+/* Identity cache kept in EEPROM by xbee_warm_start */
+typedef struct {
+    xbee_identity_type id;
+    uint16_t checksum;
+} config_cache_type;
+
+static config_cache_type EEMEM config_eeprom;
+static config_cache_type config_cache;
+
+/* Identity parameters read on a cold start, in xbee_identity_type order */
+static const char config_identity [] [2] = {
+    { 'S', 'H' }, { 'S', 'L' }, { 'M', 'Y' }, { 'N', 'P' }, { 'A', 'P' }, { 'B', 'D' }
+};
+
+/* Checks made on a warm start, all sent at once: the radio, the join, the address */
+static const char config_warm [] [2] = {
+    { 'S', 'L' }, { 'A', 'I' }, { 'M', 'Y' }
+};
+
+/* Requests in flight for xbee_at_batch, xbee_warm_start and xbee_request_many */
+static xbee_request_type batch_req [XBEE_MAX_PENDING];
+static unsigned char batch_buf [XBEE_MAX_PENDING] [4];
+static timer_type batch_timer [XBEE_MAX_PENDING];
+/* The request each slot of xbee_request_many holds, -1 if none */
+static int batch_index [XBEE_MAX_PENDING];
+
+/* Lets the next entry point in, passing the result through */
+static int config_leave (int r) {
+    config_busy = 0;
+    return r;
+}
+
+/* Prepares config_req for an AT command with a numeric parameter of "size" bytes */
+static void config_at (char c1, char c2, uint32_t value, uint16_t size) {
+    config_data [0] = byte3 (value);
+    config_data [1] = byte2 (value);
+    config_data [2] = byte1 (value);
+    config_data [3] = byte0 (value);
+
+    config_req.req = xbee_request_at;
+    config_req.args.at.cmd [0] = c1;
+    config_req.args.at.cmd [1] = c2;
+    config_req.args.at.data_ptr = config_data + sizeof config_data - size;
+    config_req.args.at.data_size = size;
+    config_req.args.at.buf_ptr = config_buf;
+    config_req.args.at.buf_size = sizeof config_buf;
+}
+
+/* Fletcher checksum of the cached identity: never 0xFFFF, as in erased EEPROM */
+static uint16_t config_checksum (void) {
+    const unsigned char * p = (const unsigned char *) &config_cache.id;
+    uint16_t a = 1, b = 0;
+    size_t i;
+
+    for (i = 0; i < sizeof config_cache.id; i ++) {
+        a = (a + p [i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+/* The baud rate of a BD value: a code for the standard rates, the rate itself otherwise */
+static uint32_t config_rate (uint32_t bd) {
+    int i;
+
+    for (i = 0; i < (int) (sizeof config_rates / sizeof config_rates [0]); i ++)
+        if (config_rates [i].bd == bd)
+            return config_rates [i].rate;
+    return bd;
+}
+
+/* Minimal number of bytes holding the value */
+static uint16_t config_size (uint32_t value) {
+    if (value > 0xFFFFFFUL)
+        return 4;
+    if (value > 0xFFFFUL)
+        return 3;
+    if (value > 0xFFUL)
+        return 2;
+    return 1;
+}
+
+/* The numeric value reported by the radio */
+static uint32_t config_value (const xbee_request_type * req_ptr) {
+    const unsigned char * buf = req_ptr->args.at.buf_ptr;
+    uint32_t value = 0;
+    uint16_t i;
+
+    for (i = 0; i < req_ptr->args.at.recv_size; i ++)
+        value = (value << 8) | buf [i];
+    return value;
+}
+
+/**
+ * @brief  Move the radio and the UART to the fastest reliable baud rate
+ *
+ * Steps up through the rates that can be generated from F_CPU within
+ * UART_BAUD_TOLERANCE. Each step is queued with ATBD (API frame 0x09),
+ * applied with ATAC, whose response still comes at the old rate, and
+ * checked with XBEE_BAUD_CHECKS round trips at the new rate. The checks
+ * are made even when the response to AC is lost, since the radio may
+ * have switched anyway. On a failure the previous rate is restored on
+ * both sides and the negotiation stops.
+ *
+ * @param  [in,out] rate_ptr  highest rate to try; receives the rate in use
+ */
+void xbee_negotiate_baudrate (uint32_t * rate_ptr) {
+    xbee_stats_type before, after;
+    uint32_t old_rate, old_bd;
+    timer_type pause;
+    int i, k, r, ok;
+
+    SynthOS_wait (!config_busy);
+    config_busy = 1;
+
+    old_rate = uart_baudrate [0];
+    old_bd = old_rate;
+    for (i = 0; i < (int) (sizeof config_rates / sizeof config_rates [0]); i ++)
+        if (config_rates [i].rate == old_rate)
+            old_bd = config_rates [i].bd;
+
+    for (i = 0; i < (int) (sizeof config_rates / sizeof config_rates [0]); i ++) {
+        if (
+          config_rates [i].rate <= old_rate ||
+          uart_baudrate_error (config_rates [i].rate) > UART_BAUD_TOLERANCE
+        )
+            continue;
+        if (config_rates [i].rate > *rate_ptr)
+            break;
+
+        /* Queued: applied by AC, after its response */
+        config_at ('B', 'D', config_rates [i].bd, config_size (config_rates [i].bd));
+        config_req.req = xbee_request_at_queue;
+        r = SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        if (r != 1 || config_req.args.at.status != 0)
+            /* The radio does not support the rate */
+            continue;
+
+        /* Even without a response the radio may have switched: the checks tell */
+        config_at ('A', 'C', 0, 0);
+        SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+
+        uart_set_baudrate (0, config_rates [i].rate);
+
+        /* Let the radio switch over */
+        timer_arm (&pause, 2);
+        SynthOS_wait (pause.fired);
+
+        xbee_get_stats (0, &before);
+        ok = 1;
+        for (k = 0; k < XBEE_BAUD_CHECKS && ok; k ++) {
+            config_at ('B', 'D', 0, 0);
+            r = SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+            ok = r == 1 && config_req.args.at.status == 0 && config_value (&config_req) == config_rates [i].bd;
+        }
+        xbee_get_stats (0, &after);
+        if (
+          after.drop_checksum != before.drop_checksum ||
+          after.drop_partial != before.drop_partial ||
+          after.uart_overruns != before.uart_overruns ||
+          after.uart_frame_errors != before.uart_frame_errors
+        )
+            ok = 0;
+
+        if (ok) {
+            old_rate = config_rates [i].rate;
+            old_bd = config_rates [i].bd;
+            continue;
+        }
+
+        /* Fall back: the radio may still understand us at the new rate */
+        config_at ('B', 'D', old_bd, config_size (old_bd));
+        config_req.req = xbee_request_at_queue;
+        SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        config_at ('A', 'C', 0, 0);
+        SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        uart_set_baudrate (0, old_rate);
+        timer_arm (&pause, 2);
+        SynthOS_wait (pause.fired);
+
+        /* A radio that never left the old rate has the new one queued: drop it */
+        config_at ('B', 'D', old_bd, config_size (old_bd));
+        config_req.req = xbee_request_at_queue;
+        SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        config_at ('A', 'C', 0, 0);
+        SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        break;
+    }
+
+    *rate_ptr = uart_baudrate [0];
+    config_busy = 0;
+}
+
+/**
+ * @brief  Set a number of parameters and apply them at once
+ *
+ * The commands are sent as queued parameter values (API frame 0x09)
+ * without waiting for each response: up to XBEE_MAX_PENDING of them
+ * are in flight at a time. The radio applies them all with the final
+ * ATAC, so a slow parameter (e.g. a network setting) takes effect
+ * only once.
+ *
+ * @param  [in,out] cmds  the commands; each receives its status
+ * @param  [in] count  the number of commands
+ * @return  1 if every command and the final AC succeeded, 0 otherwise
+ */
+int xbee_at_batch (xbee_at_command_type * cmds, int count) {
+    xbee_request_type * req_ptr;
+    int sent, done, slot, r, ok;
+
+    SynthOS_wait (!config_busy);
+    config_busy = 1;
+
+    ok = 1;
+    sent = done = 0;
+    while (done < count) {
+        if (sent < count && sent - done < XBEE_MAX_PENDING) {
+            slot = sent % XBEE_MAX_PENDING;
+            req_ptr = &batch_req [slot];
+            req_ptr->req = xbee_request_at_queue;
+            req_ptr->args.at.cmd [0] = cmds [sent].cmd [0];
+            req_ptr->args.at.cmd [1] = cmds [sent].cmd [1];
+            req_ptr->args.at.data_ptr = cmds [sent].data_ptr;
+            req_ptr->args.at.data_size = cmds [sent].data_size;
+            req_ptr->args.at.buf_ptr = NULL;
+            req_ptr->args.at.buf_size = 0;
+            timer_arm (&batch_timer [slot], XBEE_CONFIG_TICKS);
+            SynthOS_call (xbee_post (req_ptr));
+            sent ++;
+            continue;
+        }
+
+        /* The window is full (or everything is sent): collect the oldest */
+        slot = done % XBEE_MAX_PENDING;
+        req_ptr = &batch_req [slot];
+        SynthOS_wait (!req_ptr->busy || batch_timer [slot].fired);
+        timer_cancel (&batch_timer [slot]);
+        if (req_ptr->busy)
+            xbee_cancel (req_ptr);
+
+        cmds [done].status = req_ptr->args.at.status;
+        if (cmds [done].status != 0)
+            ok = 0;
+        done ++;
+    }
+
+    config_at ('A', 'C', 0, 0);
+    r = SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+    if (r != 1 || config_req.args.at.status != 0)
+        ok = 0;
+
+    return config_leave (ok);
+}
+
+/**
+ * @brief  Bring the radio up, using the identity cached in EEPROM if possible
+ *
+ * Warm start: when the cache is valid, the UART is set to the cached
+ * rate and ATSL, ATAI and ATMY are sent together, so they take a
+ * single round trip (fewer at a time if XBEE_MAX_PENDING is smaller).
+ * SL confirms that the same radio is attached. AI tells whether it is
+ * already associated; if not, the caller waits for @a associated as
+ * usual. MY of a joined radio replaces the cached one, which a rejoin
+ * may have changed; until the radio joins, the cached MY is reported.
+ *
+ * Cold start: the UART goes back to the rate it had on entry, the radio
+ * is reset with ATFR, the driver waits for it to join (at most
+ * XBEE_JOIN_TICKS), reads SH, SL, MY, NP, AP and BD and stores them in
+ * EEPROM.
+ *
+ * Either way @a xbee_max_payload is set from NP.
+ *
+ * @param  [out] id_ptr  receives the identity
+ * @return  1 on a warm start, 0 on a cold start, @a xbee_timeout on failure
+ */
+int xbee_warm_start (xbee_identity_type * id_ptr) {
+    uint32_t values [sizeof config_identity / sizeof config_identity [0]];
+    xbee_request_type * req_ptr;
+    uint32_t old_rate;
+    timer_type timeout;
+    int i, r, mask, count, sent, done, slot, ok;
+
+    SynthOS_wait (!config_busy);
+    config_busy = 1;
+
+    old_rate = uart_baudrate [0];
+    eeprom_read_block (&config_cache, &config_eeprom, sizeof config_cache);
+    if (config_cache.checksum == config_checksum ()) {
+        if (config_cache.id.baudrate != uart_baudrate [0])
+            uart_set_baudrate (0, config_cache.id.baudrate);
+
+        /* Windowed as in xbee_at_batch; values [k] is the answer to config_warm [k] */
+        count = (int) (sizeof config_warm / sizeof config_warm [0]);
+        ok = 1;
+        sent = done = 0;
+        while (done < count) {
+            if (sent < count && sent - done < XBEE_MAX_PENDING) {
+                slot = sent % XBEE_MAX_PENDING;
+                req_ptr = &batch_req [slot];
+                req_ptr->req = xbee_request_at;
+                req_ptr->args.at.cmd [0] = config_warm [sent] [0];
+                req_ptr->args.at.cmd [1] = config_warm [sent] [1];
+                req_ptr->args.at.data_ptr = NULL;
+                req_ptr->args.at.data_size = 0;
+                req_ptr->args.at.buf_ptr = batch_buf [slot];
+                req_ptr->args.at.buf_size = sizeof batch_buf [slot];
+                timer_arm (&batch_timer [slot], XBEE_CONFIG_TICKS);
+                SynthOS_call (xbee_post (req_ptr));
+                sent ++;
+                continue;
+            }
+
+            slot = done % XBEE_MAX_PENDING;
+            req_ptr = &batch_req [slot];
+            SynthOS_wait (!req_ptr->busy || batch_timer [slot].fired);
+            timer_cancel (&batch_timer [slot]);
+            if (req_ptr->busy)
+                xbee_cancel (req_ptr);
+            if (req_ptr->args.at.status == 0)
+                values [done] = config_value (req_ptr);
+            else
+                ok = 0;
+            done ++;
+        }
+
+        if (ok && values [0] == config_cache.id.sl) {
+            if (values [1] == 0) {
+                mask = get_mask ();
+                associated |= 1;
+                set_mask (mask);
+
+                if (values [2] != config_cache.id.my) {
+                    config_cache.id.my = values [2];
+                    config_cache.checksum = config_checksum ();
+                    eeprom_update_block (&config_cache, &config_eeprom, sizeof config_cache);
+                }
+            }
+            *id_ptr = config_cache.id;
+            xbee_max_payload = config_cache.id.np;
+            return config_leave (1);
+        }
+    }
+
+    /* Cold start: a radio that was reset or replaced is still at the old rate */
+    if (uart_baudrate [0] != old_rate)
+        uart_set_baudrate (0, old_rate);
+
+    config_at ('F', 'R', 0, 0);
+    r = SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+    if (r != 1 || config_req.args.at.status != 0)
+        return config_leave (xbee_timeout);
+
+    /* MY is only assigned once the radio has joined */
+    timer_arm (&timeout, XBEE_JOIN_TICKS);
+    SynthOS_wait ((associated & 1) || timeout.fired);
+    timer_cancel (&timeout);
+    if (!(associated & 1))
+        return config_leave (xbee_timeout);
+
+    for (i = 0; i < (int) (sizeof values / sizeof values [0]); i ++) {
+        config_at (config_identity [i] [0], config_identity [i] [1], 0, 0);
+        r = SynthOS_call (xbee_request_timed (&config_req, XBEE_CONFIG_TICKS));
+        if (r != 1 || config_req.args.at.status != 0)
+            return config_leave (xbee_timeout);
+        values [i] = config_value (&config_req);
+    }
+
+    config_cache.id.sh = values [0];
+    config_cache.id.sl = values [1];
+    config_cache.id.my = values [2];
+    config_cache.id.np = values [3];
+    config_cache.id.ap = values [4];
+    config_cache.id.baudrate = config_rate (values [5]);
+    config_cache.checksum = config_checksum ();
+    eeprom_update_block (&config_cache, &config_eeprom, sizeof config_cache);
+
+    *id_ptr = config_cache.id;
+    xbee_max_payload = config_cache.id.np;
+    return config_leave (0);
+}
+
+/* A slot of xbee_request_many whose request is answered or out of time, -1 if none */
+static int batch_finished (xbee_request_type * reqs) {
+    int slot;
+
+    for (slot = 0; slot < XBEE_MAX_PENDING; slot ++)
+        if (batch_index [slot] >= 0 && (!reqs [batch_index [slot]].busy || batch_timer [slot].fired))
+            return slot;
+    return -1;
+}
+
+/**
+ * @brief  Execute a number of requests, many of them at a time
+ *
+ * Up to XBEE_MAX_PENDING requests are in flight at once, and the
+ * responses are collected as they come. This is meant for remote AT
+ * commands (@c xbee_request_remote_at) sent to many nodes: each request
+ * gets its own status, and a node that does not answer costs one time
+ * limit without holding up the others.
+ *
+ * @param  [in,out] reqs  the requests (see @ref xbee_request_type)
+ * @param  [in] count  the number of requests
+ * @param  [in] ticks  time limit for each request, in clock ticks (~10ms each)
+ * @return  the number of requests that got a response
+ */
+int xbee_request_many (xbee_request_type * reqs, int count, unsigned ticks) {
+    int sent, done, answered, slot, r;
+
+    SynthOS_wait (!config_busy);
+    config_busy = 1;
+
+    for (slot = 0; slot < XBEE_MAX_PENDING; slot ++)
+        batch_index [slot] = -1;
+
+    answered = 0;
+    sent = done = 0;
+    while (done < count) {
+        for (slot = 0; slot < XBEE_MAX_PENDING && batch_index [slot] >= 0; slot ++)
+            ;
+        if (sent < count && slot < XBEE_MAX_PENDING) {
+            batch_index [slot] = sent;
+            timer_arm (&batch_timer [slot], ticks);
+            r = SynthOS_call (xbee_post (&reqs [sent]));
+            sent ++;
+            if (!r) {
+                /* Refused: not sent, the status tells */
+                timer_cancel (&batch_timer [slot]);
+                batch_index [slot] = -1;
+                done ++;
+            }
+            continue;
+        }
+
+        /* Whichever finishes first frees its slot for the next request */
+        SynthOS_wait (batch_finished (reqs) >= 0);
+        slot = batch_finished (reqs);
+        timer_cancel (&batch_timer [slot]);
+        if (reqs [batch_index [slot]].busy)
+            xbee_cancel (&reqs [batch_index [slot]]);
+        else
+            answered ++;
+        batch_index [slot] = -1;
+        done ++;
+    }
+
+    return config_leave (answered);
+}
@@ -0,0 +1,72 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee module configuration interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * The functions declared here share their requests and timers, so they
+ * run one at a time: a call made while another one runs waits for it to
+ * finish.
+ *
+ * Include after xbee.h.
+ */
+
+/* Time limit for a configuration request, in clock ticks (~10ms each) */
+#ifndef XBEE_CONFIG_TICKS
+#define XBEE_CONFIG_TICKS 100
+#endif
+
+/* Round trips that have to succeed at a new baud rate */
+#ifndef XBEE_BAUD_CHECKS
+#define XBEE_BAUD_CHECKS 4
+#endif
+
+/* Time limit for joining a network after a reset, in clock ticks */
+#ifndef XBEE_JOIN_TICKS
+#define XBEE_JOIN_TICKS 3000
+#endif
+
+/**
+ * @brief  An entry of an AT command batch (see @ref xbee_at_batch)
+ * @param  [in] cmd  AT command
+ * @param  [in] data_ptr  parameter value
+ * @param  [in] data_size  parameter value size
+ * @param  [out] status  reported status (@a xbee_status_timeout if none)
+ */
+typedef struct xbee_at_command {
+    char cmd [2];
+    void * data_ptr;
+    uint16_t data_size;
+    unsigned char status;
+} xbee_at_command_type;
+
+/**
+ * @brief  Radio identity and limits (see @ref xbee_warm_start)
+ * @param  sh  serial number, high part (ATSH)
+ * @param  sl  serial number, low part (ATSL)
+ * @param  my  network address (ATMY)
+ * @param  np  maximum payload (ATNP)
+ * @param  ap  API mode (ATAP)
+ * @param  baudrate  UART baud rate of the radio (ATBD)
+ */
+typedef struct xbee_identity {
+    uint32_t sh, sl;
+    uint16_t my, np;
+    unsigned char ap;
+    uint32_t baudrate;
+} xbee_identity_type;
@@ -0,0 +1,95 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee received frame types configuration
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Each frame type the receiver understands can be left out by defining
+ * its XBEE_FRAME_xxx to 0. Frames of a type that is left out are
+ * dropped (drop_type), and the requests answered by them are refused
+ * by xbee_post:
+ *   XBEE_FRAME_MODEM_STATUS         0x8A  "associated" is never set
+ *   XBEE_FRAME_TRANSMIT_STATUS      0x8B  xbee_request_transmit
+ *   XBEE_FRAME_AT_RESPONSE          0x88  xbee_request_at, xbee_request_at_queue
+ *   XBEE_FRAME_REMOTE_AT_RESPONSE   0x97  xbee_request_remote_at
+ *   XBEE_FRAME_RECEIVE              0x90  xbee_receive and friends
+ *
+ * XBEE_FRAMES (X) expands X (type, name, header) for every frame type
+ * compiled in, where "header" is called once the frame header is in
+ * (or is NULL).
+ */
+#ifndef XBEE_FRAME_MODEM_STATUS
+#define XBEE_FRAME_MODEM_STATUS 1
+#endif
+
+#ifndef XBEE_FRAME_TRANSMIT_STATUS
+#define XBEE_FRAME_TRANSMIT_STATUS 1
+#endif
+
+#ifndef XBEE_FRAME_AT_RESPONSE
+#define XBEE_FRAME_AT_RESPONSE 1
+#endif
+
+#ifndef XBEE_FRAME_REMOTE_AT_RESPONSE
+#define XBEE_FRAME_REMOTE_AT_RESPONSE 1
+#endif
+
+#ifndef XBEE_FRAME_RECEIVE
+#define XBEE_FRAME_RECEIVE 1
+#endif
+
+/* A frame type answering a request of the driver is compiled in */
+#define XBEE_FRAME_RESPONSES (XBEE_FRAME_AT_RESPONSE || XBEE_FRAME_TRANSMIT_STATUS || XBEE_FRAME_REMOTE_AT_RESPONSE)
+
+#if XBEE_FRAME_MODEM_STATUS
+#define XBEE_FRAMES_MODEM_STATUS(X) X (0x8A, modem_status, NULL)
+#else
+#define XBEE_FRAMES_MODEM_STATUS(X)
+#endif
+
+#if XBEE_FRAME_TRANSMIT_STATUS
+#define XBEE_FRAMES_TRANSMIT_STATUS(X) X (0x8B, transmit_status, NULL)
+#else
+#define XBEE_FRAMES_TRANSMIT_STATUS(X)
+#endif
+
+#if XBEE_FRAME_AT_RESPONSE
+#define XBEE_FRAMES_AT_RESPONSE(X) X (0x88, at_response, receiving_at_response_header)
+#else
+#define XBEE_FRAMES_AT_RESPONSE(X)
+#endif
+
+#if XBEE_FRAME_REMOTE_AT_RESPONSE
+#define XBEE_FRAMES_REMOTE_AT_RESPONSE(X) X (0x97, remote_at_response, receiving_remote_at_response_header)
+#else
+#define XBEE_FRAMES_REMOTE_AT_RESPONSE(X)
+#endif
+
+#if XBEE_FRAME_RECEIVE
+#define XBEE_FRAMES_RECEIVE(X) X (0x90, receive, NULL)
+#else
+#define XBEE_FRAMES_RECEIVE(X)
+#endif
+
+/* The most frequent types first: the receiver looks them up in this order */
+#define XBEE_FRAMES(X)                  \
+    XBEE_FRAMES_RECEIVE (X)             \
+    XBEE_FRAMES_TRANSMIT_STATUS (X)     \
+    XBEE_FRAMES_AT_RESPONSE (X)         \
+    XBEE_FRAMES_REMOTE_AT_RESPONSE (X)  \
+    XBEE_FRAMES_MODEM_STATUS (X)
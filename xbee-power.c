@@ -0,0 +1,150 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee pin sleep control
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ */
+
+#include <string.h>
+
+#include "timer.h"
+#include "hardware.h"
+#include "synthos-support.h"
+#include "xbee.h"
+#include "xbee-power.h"
+
+#ifndef XBEE_POWER
+#error "xbee-power.c needs XBEE_POWER defined"
+#endif
+
+static xbee_power_stats_type power_stats;
+static int power_wake_requested;
+static timer_type power_timer;
+static uint32_t power_time;
+
+/* interrupt_count at the last turn of xbee_cpu_idle, turns since it changed */
+static unsigned char cpu_seen, cpu_quiet;
+
+/* ON/SLEEP change time as seen by the pin change interrupt */
+static uint32_t power_on_time (void) {
+    uint32_t t;
+    int mask;
+
+    mask = get_mask ();
+    t = radio_on_time;
+    set_mask (mask);
+    return t;
+}
+
+/**
+ * @brief  Get the sleep statistics
+ * @param  [out] st  statistics
+ */
+void xbee_get_power_stats (xbee_power_stats_type * st) {
+    memcpy (st, &power_stats, sizeof power_stats);
+}
+
+/**
+ * @brief  Wake the radio up before the sleep period is over
+ *
+ * Use it when there is something to send that cannot wait.
+ */
+void xbee_power_wake (void) {
+    power_wake_requested = 1;
+}
+
+/**
+ * @brief  Puts the radio to sleep between wake windows
+ *
+ * This is a loop task.
+ */
+void xbee_power (void) {
+    /* Wake window */
+    timer_arm (&power_timer, XBEE_POWER_WINDOW);
+    SynthOS_wait (power_timer.fired);
+    for (;;) {
+        SynthOS_wait (xbee_quiet (0));
+        timer_arm (&power_timer, XBEE_POWER_IDLE);
+        SynthOS_wait (!xbee_quiet (0) || power_timer.fired);
+        timer_cancel (&power_timer);
+        if (xbee_quiet (0))
+            break;
+    }
+
+    /* No new request gets through from now on */
+    xbee_asleep |= 1;
+
+    radio_sleep_request (1);
+    power_time = lclock ();
+    timer_arm (&power_timer, XBEE_POWER_TIMEOUT);
+    SynthOS_wait (!radio_awake () || power_timer.fired);
+    timer_cancel (&power_timer);
+    if (radio_awake ()) {
+        power_stats.failures ++;
+        radio_sleep_request (0);
+        xbee_asleep &= ~1;
+        return;
+    }
+    power_stats.sleeps ++;
+    power_stats.sleep_last = ldiff (power_time, power_on_time ());
+    if (power_stats.sleep_last > power_stats.sleep_max)
+        power_stats.sleep_max = power_stats.sleep_last;
+
+    timer_arm (&power_timer, XBEE_POWER_PERIOD);
+    SynthOS_wait (power_wake_requested || power_timer.fired);
+    timer_cancel (&power_timer);
+    /* A request made while awake ends this sleep at once */
+    power_wake_requested = 0;
+
+    radio_sleep_request (0);
+    power_time = lclock ();
+    timer_arm (&power_timer, XBEE_POWER_TIMEOUT);
+    SynthOS_wait (radio_awake () || power_timer.fired);
+    timer_cancel (&power_timer);
+    if (radio_awake ()) {
+        power_stats.wakes ++;
+        power_stats.wake_last = ldiff (power_time, power_on_time ());
+        if (power_stats.wake_last > power_stats.wake_max)
+            power_stats.wake_max = power_stats.wake_last;
+    } else
+        /* The requests held will time out */
+        power_stats.failures ++;
+    xbee_asleep &= ~1;
+}
+
+/**
+ * @brief  Stops the CPU until the next interrupt when no task is ready
+ *
+ * This is a loop task. A task becomes ready when an interrupt brings
+ * what it waits for (a received byte, a transmitted byte, a clock tick),
+ * or when a task it waits for makes progress. So the CPU is stopped only
+ * after XBEE_CPU_IDLE_ROUNDS turns of this task without an interrupt:
+ * by then every task has had its turn since the last one.
+ */
+void xbee_cpu_idle (void) {
+    int mask;
+
+    mask = get_mask ();
+    if (interrupt_count != cpu_seen) {
+        cpu_seen = interrupt_count;
+        cpu_quiet = 0;
+    } else if (++ cpu_quiet >= XBEE_CPU_IDLE_ROUNDS) {
+        /* Interrupts are enabled in the same instruction as the CPU stops */
+        cpu_quiet = 0;
+        cpu_idle ();
+    }
+    set_mask (mask);
+}
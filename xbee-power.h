@@ -0,0 +1,92 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         XBee pin sleep control interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * Needs XBEE_POWER defined for all the sources and the radio set up
+ * for pin sleep (SM=1), with SLEEP_RQ and ON/SLEEP wired as described
+ * in hardware.c.
+ *
+ * The radio is kept awake for a window of at least XBEE_POWER_WINDOW
+ * ticks, and then until the driver has been quiet (see xbee_quiet) for
+ * XBEE_POWER_IDLE ticks. Then it sleeps for XBEE_POWER_PERIOD ticks or
+ * until xbee_power_wake is called (also when it is called while the radio
+ * is awake). Transmit requests posted while the radio sleeps are held by
+ * xbee_post and go out in the next window: their time limits have to be
+ * longer than XBEE_POWER_PERIOD, or xbee_power_wake has to be called.
+ *
+ * The time the radio takes to go to sleep and to wake up is measured
+ * from the SLEEP_RQ change to the ON/SLEEP change (64us units).
+ *
+ * Everything here works with radio 0, so XBEE_RADIOS has to be 1.
+ *
+ * Include after xbee.h.
+ */
+
+/* Times in clock ticks (~10ms each) */
+#ifndef XBEE_POWER_WINDOW
+#define XBEE_POWER_WINDOW 10
+#endif
+
+#ifndef XBEE_POWER_IDLE
+#define XBEE_POWER_IDLE 2
+#endif
+
+#ifndef XBEE_POWER_PERIOD
+#define XBEE_POWER_PERIOD 500
+#endif
+
+/* Limit for ON/SLEEP to follow SLEEP_RQ */
+#ifndef XBEE_POWER_TIMEOUT
+#define XBEE_POWER_TIMEOUT 10
+#endif
+
+/*
+ * Turns of xbee_cpu_idle without an interrupt before the CPU is stopped.
+ * Each turn lets every task run once: a task woken by a chain of tasks,
+ * one waiting for the next, needs a turn per link.
+ */
+#ifndef XBEE_CPU_IDLE_ROUNDS
+#define XBEE_CPU_IDLE_ROUNDS 2
+#endif
+
+#if XBEE_CPU_IDLE_ROUNDS < 1
+#error XBEE_CPU_IDLE_ROUNDS must be at least 1
+#endif
+
+/**
+ * @brief Sleep statistics (see @ref xbee_get_power_stats)
+ *
+ * Transition times are in lclock units (64us each).
+ */
+typedef struct xbee_power_stats {
+    /** @brief Times the radio went to sleep */
+    uint16_t sleeps;
+    /** @brief Times the radio woke up */
+    uint16_t wakes;
+    /** @brief Transitions that did not complete in XBEE_POWER_TIMEOUT */
+    uint16_t failures;
+    /** @brief Last and longest time to go to sleep */
+    uint32_t sleep_last, sleep_max;
+    /** @brief Last and longest time to wake up */
+    uint32_t wake_last, wake_max;
+} xbee_power_stats_type;
+
+void xbee_get_power_stats (xbee_power_stats_type * st);
+void xbee_power_wake (void);
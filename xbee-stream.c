@@ -0,0 +1,505 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Transfer of payloads larger than one RF frame
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "timer.h"
+#include "xbee.h"
+#include "xbee-stream.h"
+
+#define byte3(v) ((unsigned char) ((v) >> 24))
+#define byte2(v) ((unsigned char) ((v) >> 16))
+#define byte1(v) ((unsigned char) ((v) >>  8))
+#define byte0(v) ((unsigned char)  (v)       )
+#define make_ulong(v3, v2, v1, v0) (                    \
+      ((uint32_t) (unsigned char) (v3) << 24) |    \
+      ((uint32_t) (unsigned char) (v2) << 16) |    \
+      ((uint32_t) (unsigned char) (v1) <<  8) |    \
+      ((uint32_t) (unsigned char) (v0))            \
+    )
+#define make_ushort(v1, v0) (                           \
+      ((uint16_t) (unsigned char) (v1) <<  8) |   \
+      ((uint16_t) (unsigned char) (v0))           \
+    )
+
+#define stream_max_fragments 32
+
+/* Fragment kinds */
+#define stream_data     0xF0
+#define stream_data_ack 0xF1 /* Data, acknowledgement requested */
+#define stream_ack      0xF2
+
+/* Stream frame structures */
+typedef union {
+    struct {
+        unsigned char kind;
+        unsigned char id;
+        unsigned char index;
+        unsigned char count;
+        unsigned char offset [2];
+    }  __attribute__ ((packed)) data;
+    struct {
+        unsigned char kind;
+        unsigned char id;
+        unsigned char count;
+        unsigned char received [4];
+    }  __attribute__ ((packed)) ack;
+} stream_header_type;
+
+typedef enum {
+    stream_slot_free,
+    stream_slot_receiving,
+    stream_slot_lent
+} stream_slot_state_type;
+
+/* Reassembly buffer */
+typedef struct {
+    stream_slot_state_type state;
+    unsigned char radio;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    unsigned char id;
+    unsigned char count;
+    uint32_t received;
+    uint16_t size;
+    unsigned last; /* clock of the last fragment */
+    unsigned char data [XBEE_STREAM_SIZE];
+} stream_slot_type;
+
+static unsigned char stream_sequence;
+
+/* Sender */
+static unsigned char stream_tx_buf [sizeof (stream_header_type) + XBEE_MAX_PAYLOAD];
+static xbee_request_type stream_tx_req [XBEE_STREAM_WINDOW];
+static unsigned char stream_tx_index [XBEE_STREAM_WINDOW]; /* the fragment each request carries */
+static uint16_t stream_tx_posted; /* requests whose status is not looked at yet */
+static int stream_tx_active;
+static unsigned char stream_tx_radio;
+
+/* Recipient */
+static unsigned char stream_rx_radios; /* radios with a receive call running */
+static stream_slot_type stream_slots [XBEE_STREAM_SLOTS];
+static xbee_request_type stream_ack_req;
+static unsigned char stream_ack_buf [sizeof (stream_header_type)];
+
+/* The last completed transfer, to acknowledge repeated fragments */
+static uint32_t stream_done_hi, stream_done_lo;
+static unsigned char stream_done_radio, stream_done_id, stream_done_count;
+
+static uint32_t stream_all (unsigned char count) {
+    return count == stream_max_fragments ? 0xFFFFFFFFUL : ((uint32_t) 1 << count) - 1;
+}
+
+static int stream_bits (uint32_t bits) {
+    int n;
+
+    for (n = 0; bits != 0; bits &= bits - 1)
+        n ++;
+    return n;
+}
+
+/* Fragment payload size: the fragment has to fit a receive slot */
+static uint16_t stream_fragment_size (void) {
+    uint16_t size;
+
+    size = xbee_max_payload;
+    if (size > XBEE_RECEIVING_BUFFER_SIZE)
+        size = XBEE_RECEIVING_BUFFER_SIZE;
+    if (size > XBEE_MAX_PAYLOAD)
+        size = XBEE_MAX_PAYLOAD;
+    return size - sizeof (((stream_header_type *) 0)->data);
+}
+
+/* Fragments whose transmit requests failed since the last call */
+static uint32_t stream_tx_failed (void) {
+    uint32_t failed = 0;
+    int k;
+
+    for (k = 0; k < XBEE_STREAM_WINDOW; k ++)
+        if ((stream_tx_posted & (1 << k)) && !stream_tx_req [k].busy) {
+            stream_tx_posted &= ~(1 << k);
+            if (stream_tx_req [k].args.transmit.status != 0)
+                failed |= (uint32_t) 1 << stream_tx_index [k];
+        }
+    return failed;
+}
+
+/* A posted transmit request got its status */
+static int stream_tx_done (void) {
+    int k;
+
+    for (k = 0; k < XBEE_STREAM_WINDOW; k ++)
+        if ((stream_tx_posted & (1 << k)) && !stream_tx_req [k].busy)
+            return 1;
+    return 0;
+}
+
+/*
+ * Diverts the stream frames somebody waits for on the radio: acknowledgements
+ * while a transfer is sent through it, data while a receive call runs.
+ * Frames of the kinds nobody waits for any more are dropped.
+ */
+static void stream_divert (unsigned char radio) {
+    xbee_frame_type * frame;
+    int tx, rx;
+
+    tx = stream_tx_active && stream_tx_radio == radio;
+    rx = (stream_rx_radios >> radio) & 1;
+    if (tx && rx)
+        xbee_divert (radio, stream_data, stream_ack);
+    else if (tx)
+        xbee_divert (radio, stream_ack, stream_ack);
+    else if (rx)
+        xbee_divert (radio, stream_data, stream_data_ack);
+    else
+        /* Nothing */
+        xbee_divert (radio, stream_ack, stream_data);
+
+    if (!tx)
+        while (xbee_take (radio, stream_ack, stream_ack, &frame))
+            xbee_release_frame (frame);
+    if (!rx)
+        while (xbee_take (radio, stream_data, stream_data_ack, &frame))
+            xbee_release_frame (frame);
+}
+
+/**
+ * @brief  Send a payload larger than one RF frame
+ * @param  st_ptr  structure contatining input data
+ *                 (see @ref xbee_stream_type)
+ * @return  1 on success, 0 if the payload is too large,
+ *          @a xbee_timeout if the recipient stopped acknowledging
+ */
+int xbee_stream_send (struct xbee_stream * st_ptr) {
+    stream_header_type * header;
+    xbee_frame_type * frame;
+    timer_type timeout;
+    uint16_t fragment, offset, len;
+    uint32_t all, sent, received, bits;
+    unsigned char id, count, i, k;
+    int retries, outstanding;
+
+    fragment = stream_fragment_size ();
+    count = (st_ptr->data_size + fragment - 1) / fragment;
+    if (count == 0 || count > stream_max_fragments)
+        return 0;
+
+    /* Only one transfer at a time */
+    SynthOS_wait (!stream_tx_active);
+    stream_tx_active = 1;
+    stream_tx_radio = st_ptr->radio;
+    stream_divert (st_ptr->radio);
+
+    id = ++ stream_sequence;
+    all = stream_all (count);
+    sent = received = 0;
+    retries = 0;
+    k = 0;
+    stream_tx_posted = 0;
+    timer_arm (&timeout, XBEE_STREAM_TIMEOUT);
+
+    while (received != all) {
+        frame = NULL;
+
+        /* What the radio could not deliver goes again at once */
+        sent &= ~stream_tx_failed ();
+        outstanding = stream_bits (sent & ~received);
+
+        /* The next fragment neither sent nor acknowledged */
+        for (i = 0; i < count && ((sent | received) & ((uint32_t) 1 << i)); i ++)
+            ;
+
+        /* Acknowledgements first: they slide the window */
+        if (!xbee_take (st_ptr->radio, stream_ack, stream_ack, &frame) && i < count && outstanding < XBEE_STREAM_WINDOW) {
+            offset = (uint16_t) i * fragment;
+            len = st_ptr->data_size - offset;
+            if (len > fragment)
+                len = fragment;
+
+            SynthOS_wait (!stream_tx_req [k].busy);
+            sent &= ~stream_tx_failed ();
+
+            header = (stream_header_type *) stream_tx_buf;
+            /*
+             * Ask for an acknowledgement every half window, and with the
+             * last fragment there is to send, so that the window keeps
+             * sliding while the fragments go out.
+             */
+            header->data.kind = (
+              (outstanding + 1) % ((XBEE_STREAM_WINDOW + 1) / 2) == 0 ||
+              outstanding + 1 == XBEE_STREAM_WINDOW ||
+              (sent | received | ((uint32_t) 1 << i)) == all
+            ) ? stream_data_ack : stream_data;
+            header->data.id = id;
+            header->data.index = i;
+            header->data.count = count;
+            header->data.offset [0] = byte1 (offset);
+            header->data.offset [1] = byte0 (offset);
+            memcpy (
+              stream_tx_buf + sizeof header->data, (unsigned char *) st_ptr->data_ptr + offset, len
+            );
+
+            stream_tx_req [k].req = xbee_request_transmit;
+            stream_tx_req [k].radio = st_ptr->radio;
+            stream_tx_req [k].args.transmit.addr_hi = st_ptr->addr_hi;
+            stream_tx_req [k].args.transmit.addr_lo = st_ptr->addr_lo;
+            stream_tx_req [k].args.transmit.addr = xbee_addr_unknown;
+            stream_tx_req [k].args.transmit.data_ptr = stream_tx_buf;
+            stream_tx_req [k].args.transmit.data_size = sizeof header->data + len;
+            /* Stays so if the request could not be started */
+            stream_tx_req [k].args.transmit.status = xbee_status_timeout;
+            /* Returns as soon as the frame is out, so the buffer can be reused */
+            SynthOS_call (xbee_post (&stream_tx_req [k]));
+            stream_tx_index [k] = i;
+            stream_tx_posted |= 1 << k;
+            k = (k + 1) % XBEE_STREAM_WINDOW;
+
+            sent |= (uint32_t) 1 << i;
+            continue;
+        }
+
+        if (frame == NULL) {
+            /* The window is full, or everything is sent */
+            SynthOS_wait (
+              xbee_diverted (st_ptr->radio, stream_ack, stream_ack) || stream_tx_done () || timeout.fired
+            );
+            xbee_take (st_ptr->radio, stream_ack, stream_ack, &frame);
+        }
+
+        if (frame == NULL && !timeout.fired)
+            /* A transmit status: a failed fragment frees the window */
+            continue;
+
+        if (frame == NULL) {
+            /* Nothing heard: send what is outstanding again */
+            if (++ retries > XBEE_STREAM_RETRIES)
+                break;
+            sent &= received;
+            timer_arm (&timeout, XBEE_STREAM_TIMEOUT);
+            continue;
+        }
+
+        header = (stream_header_type *) frame->data;
+        if (
+          frame->size >= sizeof header->ack && header->ack.id == id &&
+          frame->addr_hi == st_ptr->addr_hi && frame->addr_lo == st_ptr->addr_lo
+        ) {
+            bits = make_ulong (
+              header->ack.received [0], header->ack.received [1],
+              header->ack.received [2], header->ack.received [3]
+            ) & all;
+            if (bits & ~received)
+                retries = 0;
+            received |= bits;
+
+            timer_cancel (&timeout);
+            timer_arm (&timeout, XBEE_STREAM_TIMEOUT);
+        }
+        xbee_release_frame (frame);
+    }
+
+    timer_cancel (&timeout);
+    stream_tx_active = 0;
+    stream_divert (st_ptr->radio);
+
+    return received == all ? 1 : xbee_timeout;
+}
+
+/* Prepares stream_ack_req */
+static void stream_prepare_ack (
+  unsigned char radio, uint32_t addr_hi, uint32_t addr_lo,
+  unsigned char id, unsigned char count, uint32_t received
+) {
+    stream_header_type * header = (stream_header_type *) stream_ack_buf;
+
+    header->ack.kind = stream_ack;
+    header->ack.id = id;
+    header->ack.count = count;
+    header->ack.received [0] = byte3 (received);
+    header->ack.received [1] = byte2 (received);
+    header->ack.received [2] = byte1 (received);
+    header->ack.received [3] = byte0 (received);
+
+    stream_ack_req.req = xbee_request_transmit;
+    stream_ack_req.radio = radio;
+    stream_ack_req.args.transmit.addr_hi = addr_hi;
+    stream_ack_req.args.transmit.addr_lo = addr_lo;
+    stream_ack_req.args.transmit.addr = xbee_addr_unknown;
+    stream_ack_req.args.transmit.data_ptr = stream_ack_buf;
+    stream_ack_req.args.transmit.data_size = sizeof header->ack;
+}
+
+/* Finds the reassembly buffer for the fragment, takes a free or the stalest one if none */
+static stream_slot_type * stream_slot (unsigned char radio, uint32_t addr_hi, uint32_t addr_lo, unsigned char id) {
+    stream_slot_type * slot, * victim;
+    int i;
+
+    victim = NULL;
+    for (i = 0; i < XBEE_STREAM_SLOTS; i ++) {
+        slot = &stream_slots [i];
+        if (slot->state == stream_slot_lent)
+            continue;
+        if (
+          slot->state == stream_slot_receiving && slot->radio == radio &&
+          slot->addr_hi == addr_hi && slot->addr_lo == addr_lo
+        ) {
+            if (slot->id == id)
+                return slot;
+            /* The sender gave up on the previous transfer */
+            victim = slot;
+            break;
+        }
+        if (
+          victim == NULL || slot->state == stream_slot_free || (
+            victim->state != stream_slot_free && (int) (slot->last - victim->last) < 0
+          )
+        )
+            victim = slot;
+    }
+    if (victim == NULL)
+        return NULL;
+
+    victim->state = stream_slot_receiving;
+    victim->radio = radio;
+    victim->addr_hi = addr_hi;
+    victim->addr_lo = addr_lo;
+    victim->id = id;
+    victim->count = 0;
+    victim->received = 0;
+    victim->size = 0;
+    return victim;
+}
+
+/**
+ * @brief  Receive a payload larger than one RF frame
+ *
+ * The payload is reassembled in the driver's buffer, which is lent to
+ * the caller until the next call. Fragments are only taken while the
+ * call runs; the ones that come in between reach the application and
+ * are sent again by the sender.
+ *
+ * @param  st_ptr  structure receiving the output data
+ *                 (see @ref xbee_stream_type)
+ * @return  nonzero on success, 0 if the module is not associated
+ */
+int xbee_stream_receive (struct xbee_stream * st_ptr) {
+    stream_header_type * header;
+    stream_slot_type * slot;
+    xbee_frame_type * frame;
+    uint32_t addr_hi, addr_lo;
+    uint16_t offset, len;
+    unsigned char radio, id, index, count, ack;
+    int i, r;
+
+    radio = st_ptr->radio;
+    stream_rx_radios |= 1 << radio;
+    stream_divert (radio);
+
+    /* Take back the buffer lent by the previous call */
+    for (i = 0; i < XBEE_STREAM_SLOTS; i ++)
+        if (stream_slots [i].state == stream_slot_lent && stream_slots [i].radio == radio)
+            stream_slots [i].state = stream_slot_free;
+
+    r = 0;
+    while (r == 0) {
+        SynthOS_wait (xbee_diverted (radio, stream_data, stream_data_ack) || !(associated & (1 << radio)));
+        if (!xbee_take (radio, stream_data, stream_data_ack, &frame)) {
+            if (!(associated & (1 << radio)))
+                break;
+            continue;
+        }
+
+        header = (stream_header_type *) frame->data;
+        if (
+          frame->size < sizeof header->data ||
+          header->data.count == 0 || header->data.count > stream_max_fragments ||
+          header->data.index >= header->data.count
+        ) {
+            xbee_release_frame (frame);
+            continue;
+        }
+
+        ack = header->data.kind == stream_data_ack;
+        addr_hi = frame->addr_hi;
+        addr_lo = frame->addr_lo;
+        id = header->data.id;
+        index = header->data.index;
+        count = header->data.count;
+
+        if (
+          id == stream_done_id && count == stream_done_count && radio == stream_done_radio &&
+          addr_hi == stream_done_hi && addr_lo == stream_done_lo
+        ) {
+            xbee_release_frame (frame);
+            /* The sender missed our last acknowledgement */
+            if (ack) {
+                SynthOS_wait (!stream_ack_req.busy);
+                stream_prepare_ack (radio, addr_hi, addr_lo, id, count, stream_all (count));
+                SynthOS_call (xbee_post (&stream_ack_req));
+            }
+            continue;
+        }
+
+        slot = stream_slot (radio, addr_hi, addr_lo, id);
+        if (slot != NULL) {
+            offset = make_ushort (header->data.offset [0], header->data.offset [1]);
+            len = frame->size - sizeof header->data;
+            if ((uint32_t) offset + len > sizeof slot->data) {
+                slot->state = stream_slot_free;
+                slot = NULL;
+            } else {
+                memcpy (slot->data + offset, frame->data + sizeof header->data, len);
+                slot->count = count;
+                slot->received |= (uint32_t) 1 << index;
+                slot->last = clock;
+                if (index == count - 1)
+                    slot->size = offset + len;
+            }
+        }
+        xbee_release_frame (frame);
+        if (slot == NULL)
+            continue;
+
+        if (ack) {
+            SynthOS_wait (!stream_ack_req.busy);
+            stream_prepare_ack (radio, slot->addr_hi, slot->addr_lo, slot->id, slot->count, slot->received);
+            SynthOS_call (xbee_post (&stream_ack_req));
+        }
+
+        if (slot->received == stream_all (slot->count)) {
+            stream_done_radio = radio;
+            stream_done_hi = slot->addr_hi;
+            stream_done_lo = slot->addr_lo;
+            stream_done_id = slot->id;
+            stream_done_count = slot->count;
+            slot->state = stream_slot_lent;
+            st_ptr->addr_hi = slot->addr_hi;
+            st_ptr->addr_lo = slot->addr_lo;
+            st_ptr->data_ptr = slot->data;
+            st_ptr->data_size = slot->size;
+            r = 1;
+        }
+    }
+
+    stream_rx_radios &= ~(1 << radio);
+    stream_divert (radio);
+    return r;
+}
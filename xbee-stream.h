@@ -0,0 +1,94 @@
+/**
+ * @addtogroup    XBee
+ * @{
+ * @file
+ * @date          10-17-2026
+ *
+ * @brief         Transfer of payloads larger than one RF frame interface
+ *
+ * @copyright
+ * Copyright (c) 2014 Zeidman Technologies, Inc.
+ * 15565 Swiss Creek Lane, Cupertino California, 95014 
+ * All Rights Reserved
+ *
+ * @copyright
+ * Zeidman Technologies gives an unlimited, nonexclusive license to
+ * use this code  as long as this header comment section is kept
+ * intact in all distributions and all future versions of this file
+ * and the routines within it.
+ *
+ * Notes
+ * --------------------------------------------------------
+ * A payload is split into up to 32 fragments that fit both the radio (NP)
+ * and a receive slot of the driver. The sender keeps up to
+ * XBEE_STREAM_WINDOW fragments unacknowledged; every half window, and
+ * with the last fragment there is to send, a fragment asks the recipient
+ * for an acknowledgement, which carries the bitmap of the fragments
+ * received so far. The window slides as the acknowledgements come, while
+ * the fragments keep going out. A fragment the radio fails to deliver
+ * (transmit status) is sent again at once, and everything outstanding
+ * is sent again when no acknowledgement comes in time. The recipient
+ * reassembles the fragments by the radio and the 64 bit address of the
+ * sender.
+ *
+ * Stream frames are told apart by their first byte (0xF0 to 0xF2) and
+ * kept away from the application's receive calls (see xbee_divert)
+ * while they are waited for: acknowledgements while xbee_stream_send
+ * runs, data while xbee_stream_receive runs. Other frames reach the
+ * application as usual. A node can send a stream and receive another
+ * one at the same time.
+ *
+ * Limits: while a stream call runs, an application frame whose first
+ * byte is 0xF0 to 0xF2 is taken for a stream frame, and dropped; a node
+ * that uses streams should keep its other payloads from starting with
+ * these bytes. While no stream call runs, stream frames reach the
+ * application, which should ignore them.
+ *
+ * Include after xbee.h.
+ */
+
+/* Largest payload that can be received */
+#ifndef XBEE_STREAM_SIZE
+#define XBEE_STREAM_SIZE 512
+#endif
+
+/* Number of senders that can be reassembled at once */
+#ifndef XBEE_STREAM_SLOTS
+#define XBEE_STREAM_SLOTS 1
+#endif
+
+/* Fragments sent and not acknowledged yet, up to 16 */
+#ifndef XBEE_STREAM_WINDOW
+#define XBEE_STREAM_WINDOW XBEE_MAX_PENDING
+#endif
+
+#if XBEE_STREAM_WINDOW > 16
+#error XBEE_STREAM_WINDOW must not exceed 16
+#endif
+
+/* Time to wait for an acknowledgement, in clock ticks (~10ms each) */
+#ifndef XBEE_STREAM_TIMEOUT
+#define XBEE_STREAM_TIMEOUT 50
+#endif
+
+/* Bursts sent without an acknowledgement before giving up */
+#ifndef XBEE_STREAM_RETRIES
+#define XBEE_STREAM_RETRIES 5
+#endif
+
+/**
+ * @brief  Structure containing input and output parameters for stream transfers
+ * @param  [in,out] addr_hi  highest 32 bits of the 64 bit network address of the peer (SH)
+ * @param  [in,out] addr_lo  lowest 32 bits of the 64 bit network address of the peer (SL)
+ * @param  [in,out] data_ptr  data pointer. On receive, points to the driver's
+ *                  buffer, which is valid until the next receive call.
+ * @param  [in,out] data_size  data size
+ * @param  [in] radio  radio to send through or receive from, 0 to XBEE_RADIOS - 1
+ */
+typedef struct xbee_stream {
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    void * data_ptr;
+    uint16_t data_size;
+    unsigned char radio;
+} xbee_stream_type;
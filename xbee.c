@@ -21,14 +21,32 @@
  * Notes
  * --------------------------------------------------------
  *   XBee setup: AP=2
+ *
+ *   Up to XBEE_MAX_PENDING requests can be in flight at once. Each of
+ *   them gets its own frame ID, and the responses (0x8B, 0x88, 0x97) are
+ *   matched back to the requests by that ID.
+ *
+ *   64 to 16 bit address mappings are learned from received data frames
+ *   and transmit status frames. Transmit requests with xbee_addr_unknown
+ *   use the cached 16 bit address, which saves the network address
+ *   discovery. A mapping is forgotten when a delivery fails.
+ *
+ *   Up to XBEE_RADIOS radios are driven at once, radio n on UART port n.
+ *   Each of them has its own state (xbee_radio_type); the requests and
+ *   receive operations name the radio. The tasks are shared: a task
+ *   serves one request at a time whatever radio it is for, and
+ *   xbee_receiver decodes the bytes of all the ports. XBEE_POWER,
+ *   xbee-config.c and UART_CTS/UART_RTS support a single radio.
  */
 
 #include <stddef.h>
 #include <string.h>
 
 #include "uart.h"
+#include "timer.h"
 #include "synthos-support.h"
 #include "xbee.h"
+#include "xbee-frames.h"
 
 #define byte3(v) ((unsigned char) ((v) >> 24))
 #define byte2(v) ((unsigned char) ((v) >> 16))
@@ -60,12 +78,26 @@ typedef union {
     }  __attribute__ ((packed)) transmit;
     struct {
         unsigned char status;
-    }  __attribute__ ((packed)) status;
+    }  __attribute__ ((packed)) modem_status;
     struct {
         unsigned char id;
         char cmd [2];
         unsigned char status;
     }  __attribute__ ((packed)) at_response;
+    struct {
+        unsigned char id;
+        unsigned char addr64 [8];
+        unsigned char addr16 [2];
+        unsigned char options;
+        char cmd [2];
+    }  __attribute__ ((packed)) remote_at_request;
+    struct {
+        unsigned char id;
+        unsigned char addr64 [8];
+        unsigned char addr16 [2];
+        char cmd [2];
+        unsigned char status;
+    }  __attribute__ ((packed)) remote_at_response;
     struct {
         unsigned char id;
         unsigned char addr16 [2];
@@ -99,123 +131,638 @@ typedef enum {
     receiving_state_length_1,
     receiving_state_length_2,
     receiving_state_frame_type,
-    receiving_state_modem_status,
-    receiving_state_transmit_status,
+    receiving_state_frame,
     receiving_state_at_response,
     receiving_state_data,
-    receiving_state_data_requested
+    receiving_state_data_requested,
+    receiving_state_data_dropped
 } receiving_state_type;
 
-typedef enum {
-    expected_nothing,
-    expected_transmit_status,
-    expected_at_response,
-} expected_type;
+typedef struct xbee_radio xbee_radio_type;
+
+/* Received frame type descriptor, see xbee-frames.h */
+typedef struct {
+    unsigned char type;
+    unsigned char header_size;
+    receiving_state_type (* open) (xbee_radio_type * ctx);
+    void (* header) (xbee_radio_type * ctx);
+    void (* done) (xbee_radio_type * ctx);
+} receiving_frame_type;
+
+/* Request waiting for the response */
+typedef struct {
+    unsigned char id; /* Frame ID, 0 - free entry */
+    volatile xbee_request_type * req;
+#ifdef XBEE_LATENCY
+    uint32_t started, sent; /* lclock () at the frame start and at the last byte */
+#endif
+} pending_type;
+
+/* Address cache entry, addr == xbee_addr_unknown - free entry */
+typedef struct {
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint16_t addr;
+} cache_type;
+
+#if XBEE_RECEIVING_SLOTS > 8
+#error XBEE_RECEIVING_SLOTS must not exceed 8
+#endif
+
+#if XBEE_RADIOS > UART_PORTS
+#error XBEE_RADIOS must not exceed UART_PORTS
+#endif
+
+/* A single pair of sleep pins, see hardware.h */
+#if XBEE_RADIOS > 1 && defined (XBEE_POWER)
+#error XBEE_POWER supports a single radio
+#endif
+
+/* Driver state of a radio; radio n is attached to UART port n */
+struct xbee_radio {
+    unsigned char port;
+    volatile transmitting_state_type transmitting_state;
+    volatile int expected_data;
+
+    unsigned char transmitting_sequence;
+    transmitting_packet_type transmitting_packet;
+    uint16_t receiving_packet_size;
+    uint16_t transmitting_length_header, transmitting_length_data;
+    uint16_t receiving_length_header, receiving_length_data;
+
+    volatile unsigned char * transmitting_ptr_data, * receiving_ptr_data;
+    volatile pending_type pending [XBEE_MAX_PENDING];
+    volatile unsigned char pending_count;
+    volatile int receiving_pending;
+    volatile xbee_receive_type * receive;
+    volatile xbee_packet_type receiving_packet;
+    volatile receiving_state_type receiving_state;
+    const receiving_frame_type * receiving_frame;
+    volatile uint16_t receiving_length_read;
+    volatile uint16_t transmitting_length_written;
+    volatile int transmitting_esc, receiving_esc, receiving_bytes, receive_ok;
+    volatile unsigned char transmitting_escaped, transmitting_chk, receiving_chk;
+    /*
+     * Pool of frames received while nobody was waiting for them.
+     * receiving_used has a bit set for every slot that is either queued
+     * or lent to the application; receiving_ready is the queue itself.
+     */
+    xbee_frame_type receiving_slots [XBEE_RECEIVING_SLOTS];
+    volatile unsigned char receiving_ready [XBEE_RECEIVING_SLOTS];
+    volatile unsigned char receiving_used, receiving_slot;
+    volatile unsigned char receiving_head, receiving_count;
+    /*
+     * Frames kept apart for another layer (see xbee_divert), oldest
+     * first. They come from the same pool.
+     */
+    volatile unsigned char receiving_diverted [XBEE_RECEIVING_SLOTS];
+    volatile unsigned char receiving_diverted_count;
+    unsigned char divert, divert_first, divert_last;
+
+    volatile xbee_stats_type stats;
+
+#if XBEE_ADDR_CACHE_SIZE > 0
+    volatile cache_type cache [XBEE_ADDR_CACHE_SIZE];
+    volatile unsigned char cache_next;
+#endif
+
+#ifdef XBEE_LATENCY
+    volatile int transmitting_pending;
+    volatile xbee_latency_type latency;
+#endif
+};
 
 volatile int associated;
-volatile expected_type expected_response;
-volatile transmitting_state_type transmitting_state;
-volatile int expected_data;
-
-static unsigned char transmitting_sequence;
-static transmitting_packet_type transmitting_packet;
-static uint16_t receiving_packet_size;
-static uint16_t transmitting_length_header, transmitting_length_data;
-static uint16_t receiving_length_header, receiving_length_data;
-
-static volatile unsigned char * transmitting_ptr_data, * receiving_ptr_data;
-static volatile xbee_request_type * request;
-static volatile xbee_receive_type * receive;
-static volatile xbee_packet_type receiving_packet;
-static volatile receiving_state_type receiving_state;
-static volatile uint16_t receiving_length_read;
-static volatile uint16_t transmitting_length_written;
-static volatile int transmitting_esc, receiving_esc, receiving_bytes, receive_ok;
-static volatile unsigned char transmitting_escaped, transmitting_chk, receiving_chk;
-/* Temporary buffer for receving data */
-static volatile unsigned char receiving_buffer [XBEE_RECEIVING_BUFFER_SIZE];
+uint16_t xbee_max_payload;
+
+#ifdef XBEE_POWER
+volatile int xbee_asleep;
+#endif
+
+static xbee_radio_type radios [XBEE_RADIOS];
+/* The radio xbee_receive_frame looks at first, so that a busy one does not starve the others */
+static unsigned char receiving_next;
 
 void xbee_init (void) __attribute__ ((constructor));
 void xbee_init (void) {
-    transmitting_sequence = 0xff;
+    xbee_radio_type * ctx;
+    int n, i;
+
     associated = 0;
-    expected_response = expected_nothing;
-    expected_data = 0;
-    transmitting_state = transmitting_state_idle;
-    transmitting_esc = 0;
-    receiving_esc = 0;
-    receiving_bytes = 0;
-    receiving_state = receiving_state_frame_mark;
+    xbee_max_payload = XBEE_MAX_PAYLOAD;
+    for (n = 0; n < XBEE_RADIOS; n ++) {
+        ctx = &radios [n];
+        ctx->port = n;
+        ctx->transmitting_sequence = 0xff;
+        ctx->pending_count = 0;
+        ctx->expected_data = 0;
+        ctx->receiving_used = 0;
+        ctx->receiving_head = 0;
+        ctx->receiving_count = 0;
+        ctx->receiving_diverted_count = 0;
+        ctx->divert = 0;
+        for (i = 0; i < XBEE_RECEIVING_SLOTS; i ++)
+            ctx->receiving_slots [i].radio = n;
+        ctx->transmitting_state = transmitting_state_idle;
+        ctx->transmitting_esc = 0;
+        ctx->receiving_esc = 0;
+        ctx->receiving_bytes = 0;
+        ctx->receiving_state = receiving_state_frame_mark;
+#if XBEE_ADDR_CACHE_SIZE > 0
+        for (i = 0; i < XBEE_ADDR_CACHE_SIZE; i ++)
+            ctx->cache [i].addr = xbee_addr_unknown;
+        ctx->cache_next = 0;
+#endif
+    }
+}
+
+#ifdef XBEE_LATENCY
+/* Bucket n counts periods from 2^n to 2^(n+1)-1 time units; bucket 0 also counts 0 */
+static void latency_add (volatile uint16_t * histogram, uint32_t period) {
+    int n;
+
+    for (n = 0; period > 1 && n < XBEE_LATENCY_BUCKETS - 1; n ++)
+        period >>= 1;
+    if (histogram [n] != 0xFFFF)
+        histogram [n] ++;
+}
+
+/**
+ * @brief  Get a snapshot of the latency histograms
+ * @param  radio  the radio
+ * @param  lat  receives the histograms (see @ref xbee_latency_type)
+ */
+void xbee_get_latency (int radio, xbee_latency_type * lat) {
+    xbee_radio_type * ctx = &radios [radio];
+    int mask;
+
+    mask = get_mask ();
+    memcpy (lat, (void *) &ctx->latency, sizeof ctx->latency);
+    set_mask (mask);
 }
 
+/**
+ * @brief  Clear the latency histograms
+ * @param  radio  the radio
+ */
+void xbee_reset_latency (int radio) {
+    xbee_radio_type * ctx = &radios [radio];
+    int mask;
+
+    mask = get_mask ();
+    memset ((void *) &ctx->latency, 0, sizeof ctx->latency);
+    set_mask (mask);
+}
+#endif
+
 /*
  * Transmitter' state machine:
  *   transmitting_state: frame_mark -> length_1 -> length_2 [ -> header -> data ] -> idle
+ *   Runs in interrupt, or in task context if UART_TX_RING_SIZE is defined.
  *   Setup:
  *     transmitting_length_header (data goes to transmitting_packet);
  *     transmitting_ptr_data, transmitting_length_data.
  */
-int uart_transmit_byte (void) {
+int uart_transmit_byte (int port) {
+    xbee_radio_type * ctx = &radios [port];
     unsigned char byte;
     uint16_t len;
 
-    if (transmitting_esc) {
-        transmitting_esc = 0;
-        return transmitting_escaped ^ 0x20;
+    if (ctx->transmitting_esc) {
+        ctx->transmitting_esc = 0;
+        ctx->stats.tx_bytes ++;
+        return ctx->transmitting_escaped ^ 0x20;
     }
 
-    switch (transmitting_state) {
+    switch (ctx->transmitting_state) {
       case transmitting_state_frame_mark:
-        transmitting_state = transmitting_state_length_1;
+        ctx->transmitting_state = transmitting_state_length_1;
+        ctx->stats.tx_bytes ++;
+#ifdef XBEE_LATENCY
+        ctx->pending [ctx->transmitting_pending].started = lclock ();
+#endif
         return 0x7E;
       case transmitting_state_length_1:
-        len = transmitting_length_header + transmitting_length_data;
+        len = ctx->transmitting_length_header + ctx->transmitting_length_data;
         byte = byte1 (len);
-        transmitting_state = transmitting_state_length_2;
+        ctx->transmitting_state = transmitting_state_length_2;
         break;
       case transmitting_state_length_2:
-        len = transmitting_length_header + transmitting_length_data;
+        len = ctx->transmitting_length_header + ctx->transmitting_length_data;
         byte = byte0 (len);
-        transmitting_chk = 0;
-        transmitting_length_written = 0;
-        transmitting_state = transmitting_state_header;
+        ctx->transmitting_chk = 0;
+        ctx->transmitting_length_written = 0;
+        ctx->transmitting_state = transmitting_state_header;
         break;;
       case transmitting_state_header:
-        if (transmitting_length_written < transmitting_length_header) {
-            byte = ((unsigned char *) &transmitting_packet) [transmitting_length_written];
-            transmitting_chk += byte;
-            transmitting_length_written ++;
+        if (ctx->transmitting_length_written < ctx->transmitting_length_header) {
+            byte = ((unsigned char *) &ctx->transmitting_packet) [ctx->transmitting_length_written];
+            ctx->transmitting_chk += byte;
+            ctx->transmitting_length_written ++;
             break;
         }
-        transmitting_length_written = 0;
-        transmitting_state = transmitting_state_data;
+        ctx->transmitting_length_written = 0;
+        ctx->transmitting_state = transmitting_state_data;
         /* Fall through */
       case transmitting_state_data:
-        if (transmitting_length_written < transmitting_length_data) {
-            byte = transmitting_ptr_data  [transmitting_length_written];
-            transmitting_chk += byte;
-            transmitting_length_written ++;
+        if (ctx->transmitting_length_written < ctx->transmitting_length_data) {
+            byte = ctx->transmitting_ptr_data  [ctx->transmitting_length_written];
+            ctx->transmitting_chk += byte;
+            ctx->transmitting_length_written ++;
             break;
         }
-        byte = 0xff - transmitting_chk;
-        transmitting_state = transmitting_state_idle;
+        byte = 0xff - ctx->transmitting_chk;
+        ctx->transmitting_state = transmitting_state_idle;
+        ctx->stats.tx_frames ++;
+#ifdef XBEE_LATENCY
+        ctx->pending [ctx->transmitting_pending].sent = lclock ();
+        latency_add (ctx->latency.uart, 
+          ldiff (ctx->pending [ctx->transmitting_pending].started, ctx->pending [ctx->transmitting_pending].sent));
+#endif
         break;
       default:
         return -1;
     }
     if (byte == 0x7E || byte == 0x7D || byte == 0x13 || byte == 0x11) {
-        transmitting_escaped = byte;
-        transmitting_esc = 1;
+        ctx->transmitting_escaped = byte;
+        ctx->transmitting_esc = 1;
+        ctx->stats.tx_bytes ++;
+        ctx->stats.tx_escapes ++;
         return 0x7D;
     }
+    ctx->stats.tx_bytes ++;
     return byte;
 }
 
-static void new_sequence (void) {
-    if (transmitting_sequence == 0xff)
-        transmitting_sequence = 1;
-    else
-        transmitting_sequence ++;
+#if XBEE_ADDR_CACHE_SIZE > 0 && (XBEE_FRAME_TRANSMIT_STATUS || XBEE_FRAME_REMOTE_AT_RESPONSE || XBEE_FRAME_RECEIVE)
+static int cache_find (xbee_radio_type * ctx, uint32_t addr_hi, uint32_t addr_lo) {
+    int i;
+
+    for (i = 0; i < XBEE_ADDR_CACHE_SIZE; i ++)
+        if (
+          ctx->cache [i].addr != xbee_addr_unknown &&
+          ctx->cache [i].addr_lo == addr_lo && ctx->cache [i].addr_hi == addr_hi
+        )
+            return i;
+    return -1;
+}
+
+/* Called from interrupt */
+static void cache_learn (xbee_radio_type * ctx, uint32_t addr_hi, uint32_t addr_lo, uint16_t addr) {
+    int i;
+
+    if (addr == xbee_addr_unknown)
+        return;
+    i = cache_find (ctx, addr_hi, addr_lo);
+    if (i < 0) {
+        i = ctx->cache_next;
+        ctx->cache_next = (ctx->cache_next + 1) % XBEE_ADDR_CACHE_SIZE;
+        ctx->cache [i].addr_hi = addr_hi;
+        ctx->cache [i].addr_lo = addr_lo;
+    }
+    ctx->cache [i].addr = addr;
+}
+
+#if XBEE_FRAME_TRANSMIT_STATUS
+/* Called from interrupt */
+static void cache_forget (xbee_radio_type * ctx, uint32_t addr_hi, uint32_t addr_lo) {
+    int i;
+
+    i = cache_find (ctx, addr_hi, addr_lo);
+    if (i >= 0)
+        ctx->cache [i].addr = xbee_addr_unknown;
+}
+#endif
+
+#if XBEE_FRAME_TRANSMIT_STATUS || XBEE_FRAME_REMOTE_AT_RESPONSE
+/* Returns the cached 16 bit address or xbee_addr_unknown */
+static uint16_t cache_lookup (xbee_radio_type * ctx, uint32_t addr_hi, uint32_t addr_lo) {
+    uint16_t addr;
+    int i, mask;
+
+    mask = get_mask ();
+    i = cache_find (ctx, addr_hi, addr_lo);
+    addr = i >= 0 ? ctx->cache [i].addr : xbee_addr_unknown;
+    set_mask (mask);
+    return addr;
+}
+#endif
+#endif
+
+#if XBEE_FRAME_RESPONSES
+static int sequence_used (xbee_radio_type * ctx, unsigned char id) {
+    int i;
+
+    for (i = 0; i < XBEE_MAX_PENDING; i ++)
+        if (ctx->pending [i].id == id)
+            return 1;
+    return 0;
+}
+
+/* Picks the next frame ID that is not used by a request in flight */
+static void new_sequence (xbee_radio_type * ctx) {
+    do {
+        if (ctx->transmitting_sequence == 0xff)
+            ctx->transmitting_sequence = 1;
+        else
+            ctx->transmitting_sequence ++;
+    } while (sequence_used (ctx, ctx->transmitting_sequence));
+}
+#endif
+
+static void pending_add (xbee_radio_type * ctx, volatile xbee_request_type * req) {
+    int i, mask;
+
+    mask = get_mask ();
+    for (i = 0; i < XBEE_MAX_PENDING; i ++)
+        if (ctx->pending [i].id == 0) {
+            ctx->pending [i].req = req;
+            ctx->pending [i].id = ctx->transmitting_sequence;
+            ctx->pending_count ++;
+#ifdef XBEE_LATENCY
+            ctx->transmitting_pending = i;
+#endif
+            break;
+        }
+    set_mask (mask);
+}
+
+#if XBEE_FRAME_RESPONSES
+/* Called from interrupt */
+static int pending_find (xbee_radio_type * ctx, unsigned char id) {
+    int i;
+
+    for (i = 0; i < XBEE_MAX_PENDING; i ++)
+        if (ctx->pending [i].id == id)
+            return i;
+    return -1;
+}
+#endif
+
+/* Called from interrupt */
+static void pending_release (xbee_radio_type * ctx, int i) {
+    ctx->pending [i].req->busy = 0;
+    ctx->pending [i].id = 0;
+    ctx->pending_count --;
+}
+
+#if XBEE_FRAME_RESPONSES
+/* Called from interrupt when the response to a request arrives */
+static void pending_complete (xbee_radio_type * ctx, int i) {
+#ifdef XBEE_LATENCY
+    latency_add (ctx->latency.radio, ldiff (ctx->pending [i].sent, lclock ()));
+#endif
+    pending_release (ctx, i);
+}
+#endif
+
+/* Forgets the request: a late response will be dropped */
+static void pending_cancel (xbee_radio_type * ctx, volatile xbee_request_type * req) {
+    int i, mask;
+
+    mask = get_mask ();
+    for (i = 0; i < XBEE_MAX_PENDING; i ++)
+        if (ctx->pending [i].id != 0 && ctx->pending [i].req == req) {
+            if (ctx->receiving_state == receiving_state_at_response && ctx->receiving_pending == i) {
+                /* The response is coming in right now: skip the rest of it */
+                ctx->receiving_pending = -1;
+                ctx->receiving_length_data = 0;
+            }
+            pending_release (ctx, i);
+            break;
+        }
+    set_mask (mask);
+}
+
+/* Sets the status of the request to xbee_status_timeout */
+static void request_expire (xbee_request_type * req_ptr) {
+    switch (req_ptr->req) {
+      case xbee_request_at:
+      case xbee_request_at_queue:
+        req_ptr->args.at.status = xbee_status_timeout;
+        break;
+      case xbee_request_transmit:
+        req_ptr->args.transmit.status = xbee_status_timeout;
+        break;
+      case xbee_request_remote_at:
+        req_ptr->args.remote_at.status = xbee_status_timeout;
+        break;
+    }
+}
+
+/**
+ * @brief  Stop waiting for the response to a request sent by @ref xbee_post
+ *
+ * The status of the request is set to @a xbee_status_timeout.
+ * A late response will be dropped.
+ *
+ * @param  req_ptr  the request
+ */
+void xbee_cancel (xbee_request_type * req_ptr) {
+    pending_cancel (&radios [req_ptr->radio], req_ptr);
+    request_expire (req_ptr);
+}
+
+static int transmitter_ready (xbee_radio_type * ctx) {
+#ifdef XBEE_POWER
+    /* Held until the next wake window */
+    if (xbee_asleep & (1 << ctx->port))
+        return 0;
+#endif
+    return ctx->transmitting_state == transmitting_state_idle && ctx->pending_count < XBEE_MAX_PENDING;
+}
+
+/**
+ * @brief  Check that nothing is going on between the driver and a radio
+ * @param  radio  the radio
+ * @return  nonzero if no request is being sent or waits for its response
+ */
+int xbee_quiet (int radio) {
+    xbee_radio_type * ctx = &radios [radio];
+
+#ifdef UART_TX_RING_SIZE
+    if (uart_tx_space (ctx->port) != UART_TX_RING_SIZE - 1)
+        return 0;
+#endif
+    return ctx->transmitting_state == transmitting_state_idle && ctx->pending_count == 0;
+}
+
+/*
+ * Fills transmitting_packet for the request, registers the request
+ * as pending and starts the transmitter.
+ * Returns 0 for unknown requests, and for requests whose response
+ * frame type is not compiled in (see xbee-frames.h).
+ */
+static int start_request (xbee_radio_type * ctx, xbee_request_type * req) {
+#if XBEE_FRAME_TRANSMIT_STATUS || XBEE_FRAME_REMOTE_AT_RESPONSE
+    uint16_t addr;
+#endif
+
+    switch (req->req) {
+#if XBEE_FRAME_AT_RESPONSE
+      case xbee_request_at:
+      case xbee_request_at_queue:
+        new_sequence (ctx);
+        ctx->transmitting_packet.type = req->req == xbee_request_at ? 0x08 : 0x09;
+        ctx->transmitting_packet.header.at_request.id = ctx->transmitting_sequence;
+        ctx->transmitting_packet.header.at_request.cmd [0] = req->args.at.cmd [0];
+        ctx->transmitting_packet.header.at_request.cmd [1] = req->args.at.cmd [1];
+        ctx->transmitting_length_header = 
+            offsetof (transmitting_packet_type, header) + sizeof ctx->transmitting_packet.header.at_request;
+        ctx->transmitting_ptr_data = (unsigned char *) req->args.at.data_ptr;
+        ctx->transmitting_length_data = req->args.at.data_size;
+        break;
+#endif
+#if XBEE_FRAME_TRANSMIT_STATUS
+      case xbee_request_transmit:
+        new_sequence (ctx);
+        ctx->transmitting_packet.type = 0x10;
+        ctx->transmitting_packet.header.transmit.id = ctx->transmitting_sequence;
+        req->args.transmit.id = ctx->transmitting_sequence;
+        ctx->transmitting_packet.header.transmit.addr64 [0] = byte3 (req->args.transmit.addr_hi);
+        ctx->transmitting_packet.header.transmit.addr64 [1] = byte2 (req->args.transmit.addr_hi);
+        ctx->transmitting_packet.header.transmit.addr64 [2] = byte1 (req->args.transmit.addr_hi);
+        ctx->transmitting_packet.header.transmit.addr64 [3] = byte0 (req->args.transmit.addr_hi);
+        ctx->transmitting_packet.header.transmit.addr64 [4] = byte3 (req->args.transmit.addr_lo);
+        ctx->transmitting_packet.header.transmit.addr64 [5] = byte2 (req->args.transmit.addr_lo);
+        ctx->transmitting_packet.header.transmit.addr64 [6] = byte1 (req->args.transmit.addr_lo);
+        ctx->transmitting_packet.header.transmit.addr64 [7] = byte0 (req->args.transmit.addr_lo);
+        addr = req->args.transmit.addr;
+#if XBEE_ADDR_CACHE_SIZE > 0
+        if (addr == xbee_addr_unknown)
+            addr = cache_lookup (ctx, req->args.transmit.addr_hi, req->args.transmit.addr_lo);
+#endif
+        ctx->transmitting_packet.header.transmit.addr16 [0] = byte1 (addr);
+        ctx->transmitting_packet.header.transmit.addr16 [1] = byte0 (addr);
+        ctx->transmitting_packet.header.transmit.radius = 0;
+        ctx->transmitting_packet.header.transmit.options = 0;
+        ctx->transmitting_length_header = 
+            offsetof (transmitting_packet_type, header) + sizeof ctx->transmitting_packet.header.transmit;
+        ctx->transmitting_ptr_data = req->args.transmit.data_ptr;
+        ctx->transmitting_length_data = req->args.transmit.data_size;
+        break;
+#endif
+#if XBEE_FRAME_REMOTE_AT_RESPONSE
+      case xbee_request_remote_at:
+        new_sequence (ctx);
+        ctx->transmitting_packet.type = 0x17;
+        ctx->transmitting_packet.header.remote_at_request.id = ctx->transmitting_sequence;
+        ctx->transmitting_packet.header.remote_at_request.addr64 [0] = byte3 (req->args.remote_at.addr_hi);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [1] = byte2 (req->args.remote_at.addr_hi);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [2] = byte1 (req->args.remote_at.addr_hi);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [3] = byte0 (req->args.remote_at.addr_hi);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [4] = byte3 (req->args.remote_at.addr_lo);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [5] = byte2 (req->args.remote_at.addr_lo);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [6] = byte1 (req->args.remote_at.addr_lo);
+        ctx->transmitting_packet.header.remote_at_request.addr64 [7] = byte0 (req->args.remote_at.addr_lo);
+        addr = req->args.remote_at.addr;
+#if XBEE_ADDR_CACHE_SIZE > 0
+        if (addr == xbee_addr_unknown)
+            addr = cache_lookup (ctx, req->args.remote_at.addr_hi, req->args.remote_at.addr_lo);
+#endif
+        ctx->transmitting_packet.header.remote_at_request.addr16 [0] = byte1 (addr);
+        ctx->transmitting_packet.header.remote_at_request.addr16 [1] = byte0 (addr);
+        ctx->transmitting_packet.header.remote_at_request.options = req->args.remote_at.options;
+        ctx->transmitting_packet.header.remote_at_request.cmd [0] = req->args.remote_at.cmd [0];
+        ctx->transmitting_packet.header.remote_at_request.cmd [1] = req->args.remote_at.cmd [1];
+        ctx->transmitting_length_header = 
+            offsetof (transmitting_packet_type, header) + sizeof ctx->transmitting_packet.header.remote_at_request;
+        ctx->transmitting_ptr_data = (unsigned char *) req->args.remote_at.data_ptr;
+        ctx->transmitting_length_data = req->args.remote_at.data_size;
+        break;
+#endif
+      default:
+        return 0;
+    }
+
+    req->busy = 1;
+    pending_add (ctx, req);
+
+    ctx->transmitting_state = transmitting_state_frame_mark;
+    return 1;
+}
+
+#ifdef UART_TX_RING_SIZE
+/*
+ * Runs the transmitter' state machine in task context and puts
+ * the encoded bytes to the transmit ring.
+ * Returns nonzero when the whole frame is in the ring.
+ */
+static int transmitting_encode (xbee_radio_type * ctx) {
+    int x;
+
+    for (;;) {
+        if (uart_tx_space (ctx->port) == 0) {
+            uart_transmit (ctx->port);
+            return 0;
+        }
+        x = uart_transmit_byte (ctx->port);
+        if (x == -1)
+            break;
+        uart_tx_put (ctx->port, (unsigned char) x);
+    }
+    uart_transmit (ctx->port);
+    return 1;
+}
+#endif
+
+/* Drops the rest of a frame that could not be sent in time */
+static void transmitting_abort (xbee_radio_type * ctx) {
+    int mask;
+
+    mask = get_mask ();
+    if (ctx->transmitting_state != transmitting_state_idle) {
+        ctx->transmitting_state = transmitting_state_idle;
+        ctx->transmitting_esc = 0;
+    }
+    set_mask (mask);
+}
+
+/**
+ * @brief  Send XBee request without waiting for the response
+ *
+ * Returns as soon as the frame has been passed to the UART, so the data
+ * buffer can be reused. The request stays in flight (@a busy is nonzero)
+ * until the response arrives. Use @ref xbee_wait to wait for it.
+ *
+ * A request whose response frame type is not compiled in (see
+ * xbee-frames.h) is refused: it is not sent, @a busy stays 0 and the
+ * status is set to @a xbee_status_timeout.
+ *
+ * @param  req_ptr  structure contatining input and output data
+ *                  (see @ref xbee_request_type)
+ * @return  1 if the request was sent, 0 if it was refused
+ */
+int xbee_post (struct xbee_request * req_ptr) {
+    xbee_radio_type * ctx;
+
+    ctx = &radios [req_ptr->radio];
+
+    SynthOS_wait (transmitter_ready (ctx));
+
+    if (!start_request (ctx, req_ptr)) {
+        request_expire (req_ptr);
+        return 0;
+    }
+
+#ifdef UART_TX_RING_SIZE
+    while (!transmitting_encode (ctx))
+        SynthOS_wait (uart_tx_space (ctx->port) != 0);
+#else
+    uart_transmit (ctx->port);
+
+    SynthOS_wait (ctx->transmitting_state == transmitting_state_idle);
+#endif
+    return 1;
+}
+
+/**
+ * @brief  Wait for the response to a request sent by @ref xbee_post
+ * @param  req_ptr  structure contatining input and output data
+ *                  (see @ref xbee_request_type)
+ */
+void xbee_wait (struct xbee_request * req_ptr) {
+    SynthOS_wait (!req_ptr->busy);
 }
 
 /**
@@ -224,305 +771,805 @@ static void new_sequence (void) {
  *                  (see @ref xbee_request_type)
  */
 void xbee_request (struct xbee_request * req_ptr) {
-    unsigned char b, chk, * bufp1, * bufp2;
-    unsigned bufs1, bufs2, len;
-    xbee_packet_type opack;
+    SynthOS_call (xbee_post (req_ptr));
 
-    switch (req_ptr->req) {
-      case xbee_request_at:
-        request = req_ptr;
-        new_sequence ();
-        transmitting_packet.type = 0x08;
-        transmitting_packet.header.at_request.id = transmitting_sequence;
-        transmitting_packet.header.at_request.cmd [0] = request->args.at.cmd [0];
-        transmitting_packet.header.at_request.cmd [1] = request->args.at.cmd [1];
-        transmitting_length_header = 
-            offsetof (transmitting_packet_type, header) + sizeof transmitting_packet.header.at_request;
-        transmitting_ptr_data = (unsigned char *) request->args.at.data_ptr;
-        transmitting_length_data = request->args.at.data_size;
-        expected_response = expected_at_response;
+    SynthOS_wait (!req_ptr->busy);
+}
+
+/**
+ * @brief  Execute XBee request with a time limit
+ *
+ * The limit covers the whole request: waiting for the transmitter, sending
+ * the frame (which stalls while the radio holds CTS off) and waiting for
+ * the response. On timeout, the status of the request is set to
+ * @a xbee_status_timeout and the request is forgotten: a late response
+ * will be dropped. A frame that is not sent out completely in time is
+ * cut short; the radio drops it.
+ *
+ * @param  req_ptr  structure contatining input and output data
+ *                  (see @ref xbee_request_type)
+ * @param  ticks  time limit in clock ticks (~10ms each)
+ * @return  1 on success, @a xbee_timeout if the time is out,
+ *          @a xbee_refused if the request type is not compiled in
+ *          (see xbee-frames.h)
+ */
+int xbee_request_timed (struct xbee_request * req_ptr, unsigned ticks) {
+    xbee_radio_type * ctx;
+    timer_type timeout;
+
+    timer_arm (&timeout, ticks);
+    ctx = &radios [req_ptr->radio];
+
+    SynthOS_wait (transmitter_ready (ctx) || timeout.fired);
+
+    if (transmitter_ready (ctx) && !timeout.fired) {
+        /* As xbee_post does, with the time limit */
+        if (!start_request (ctx, req_ptr)) {
+            timer_cancel (&timeout);
+            request_expire (req_ptr);
+            return xbee_refused;
+        }
+#ifdef UART_TX_RING_SIZE
+        while (!transmitting_encode (ctx) && !timeout.fired)
+            SynthOS_wait (uart_tx_space (ctx->port) != 0 || timeout.fired);
+#else
+        uart_transmit (ctx->port);
+
+        SynthOS_wait (ctx->transmitting_state == transmitting_state_idle || timeout.fired);
+#endif
+        transmitting_abort (ctx);
+
+        SynthOS_wait (!req_ptr->busy || timeout.fired);
+
+        if (!req_ptr->busy) {
+            timer_cancel (&timeout);
+            return 1;
+        }
+    }
+
+    timer_cancel (&timeout);
+    xbee_cancel (req_ptr);
+    return xbee_timeout;
+}
+
+#if XBEE_FRAME_AT_RESPONSE || XBEE_FRAME_REMOTE_AT_RESPONSE || XBEE_FRAME_RECEIVE
+/* Called from interrupt: counts frames with data beyond the buffer */
+static void receiving_truncated (xbee_radio_type * ctx) {
+    if (ctx->receiving_packet_size - ctx->receiving_length_header > ctx->receiving_length_data)
+        ctx->stats.truncated ++;
+}
+#endif
+
+/*
+ * Frame handlers, all called from interrupt (see xbee-frames.h):
+ *   receiving_xxx_open - the frame type is known and the frame is long
+ *     enough for the header. Sets up the data and returns the state
+ *     to continue with, receiving_state_frame_mark drops the frame.
+ *   receiving_xxx_done - the frame is complete and its checksum is fine.
+ */
+
+#if XBEE_FRAME_MODEM_STATUS
+static receiving_state_type receiving_modem_status_open (xbee_radio_type * ctx) {
+    (void) ctx;
+    return receiving_state_frame;
+}
+
+static void receiving_modem_status_done (xbee_radio_type * ctx) {
+    switch (ctx->receiving_packet.modem_status.status) {
+      case 0x00:
+      case 0x01:
+        ctx->stats.modem_reset ++;
         break;
-      case xbee_request_transmit:
-        request = req_ptr;
-        new_sequence ();
-        transmitting_packet.type = 0x10;
-        transmitting_packet.header.transmit.id = transmitting_sequence;
-        transmitting_packet.header.transmit.addr64 [0] = byte3 (request->args.transmit.addr_hi);
-        transmitting_packet.header.transmit.addr64 [1] = byte2 (request->args.transmit.addr_hi);
-        transmitting_packet.header.transmit.addr64 [2] = byte1 (request->args.transmit.addr_hi);
-        transmitting_packet.header.transmit.addr64 [3] = byte0 (request->args.transmit.addr_hi);
-        transmitting_packet.header.transmit.addr64 [4] = byte3 (request->args.transmit.addr_lo);
-        transmitting_packet.header.transmit.addr64 [5] = byte2 (request->args.transmit.addr_lo);
-        transmitting_packet.header.transmit.addr64 [6] = byte1 (request->args.transmit.addr_lo);
-        transmitting_packet.header.transmit.addr64 [7] = byte0 (request->args.transmit.addr_lo);
-        transmitting_packet.header.transmit.addr16 [0] = byte1 (request->args.transmit.addr);
-        transmitting_packet.header.transmit.addr16 [1] = byte0 (request->args.transmit.addr);
-        transmitting_packet.header.transmit.radius = 0;
-        transmitting_packet.header.transmit.options = 0;
-        transmitting_length_header = 
-            offsetof (transmitting_packet_type, header) + sizeof transmitting_packet.header.transmit;
-        transmitting_ptr_data = request->args.transmit.data_ptr;
-        transmitting_length_data = request->args.transmit.data_size;
-        expected_response = expected_transmit_status;
+      case 0x02:
+        associated |= 1 << ctx->port;
+        ctx->stats.modem_joined ++;
+        break;
+      case 0x03:
+        associated &= ~(1 << ctx->port);
+        if (ctx->expected_data)
+            ctx->expected_data = 0;
+        ctx->stats.modem_left ++;
         break;
       default:
-        return;
+        ctx->stats.modem_other ++;
+        break;
     }
+}
+#endif
 
-    transmitting_state = transmitting_state_frame_mark;
-    uart_transmit ();
+#if XBEE_FRAME_TRANSMIT_STATUS
+static receiving_state_type receiving_transmit_status_open (xbee_radio_type * ctx) {
+    if (ctx->pending_count == 0) {
+        ctx->stats.drop_unexpected ++;
+        return receiving_state_frame_mark;
+    }
+    return receiving_state_frame;
+}
 
-    SynthOS_wait (transmitting_state == transmitting_state_idle);
+static void receiving_transmit_status_done (xbee_radio_type * ctx) {
+    int i;
 
-    SynthOS_wait (expected_response == expected_nothing);
+    i = pending_find (ctx, ctx->receiving_packet.transmit_status.id);
+    if (i >= 0 && ctx->pending [i].req->req == xbee_request_transmit) {
+#if XBEE_ADDR_CACHE_SIZE > 0
+        if (ctx->receiving_packet.transmit_status.delivery == 0)
+            cache_learn (ctx, 
+              ctx->pending [i].req->args.transmit.addr_hi, ctx->pending [i].req->args.transmit.addr_lo,
+              make_ushort (
+                ctx->receiving_packet.transmit_status.addr16 [0], ctx->receiving_packet.transmit_status.addr16 [1]
+              )
+            );
+        else
+            cache_forget (ctx, ctx->pending [i].req->args.transmit.addr_hi, ctx->pending [i].req->args.transmit.addr_lo);
+#endif
+        ctx->pending [i].req->args.transmit.status = ctx->receiving_packet.transmit_status.delivery;
+        ctx->pending [i].req->args.transmit.retries = ctx->receiving_packet.transmit_status.retries;
+        ctx->pending [i].req->args.transmit.discovery = ctx->receiving_packet.transmit_status.discovery;
+        pending_complete (ctx, i);
+    } else
+        ctx->stats.drop_unexpected ++;
 }
+#endif
+
+#if XBEE_FRAME_AT_RESPONSE || XBEE_FRAME_REMOTE_AT_RESPONSE
+/*
+ * Finds the request an AT response (local or remote) is for.
+ * Both headers start with the frame ID.
+ */
+static volatile xbee_request_type * receiving_at_request (xbee_radio_type * ctx, xbee_request_selector_type r1, xbee_request_selector_type r2) {
+    volatile xbee_request_type * req;
+    int i;
+
+    ctx->receiving_pending = -1;
+    i = pending_find (ctx, ctx->receiving_packet.at_response.id);
+    if (i < 0)
+        return NULL;
+    req = ctx->pending [i].req;
+    if (req->req != r1 && req->req != r2)
+        return NULL;
+    ctx->receiving_pending = i;
+    ctx->receiving_length_data = ctx->receiving_packet_size - ctx->receiving_length_header;
+    return req;
+}
+
+static receiving_state_type receiving_at_open (xbee_radio_type * ctx) {
+    if (ctx->pending_count == 0) {
+        ctx->stats.drop_unexpected ++;
+        return receiving_state_frame_mark;
+    }
+    return receiving_state_at_response; /* The data is set up by the header handler */
+}
+#endif
+
+#if XBEE_FRAME_AT_RESPONSE
+/* Once the header is in, the frame ID tells where the data goes */
+static void receiving_at_response_header (xbee_radio_type * ctx) {
+    volatile xbee_request_type * req;
+
+    req = receiving_at_request (ctx, xbee_request_at, xbee_request_at_queue);
+    if (req == NULL)
+        return;
+    if (ctx->receiving_length_data > req->args.at.buf_size)
+        ctx->receiving_length_data = req->args.at.buf_size;
+    ctx->receiving_ptr_data = (unsigned char *) req->args.at.buf_ptr;
+    req->args.at.recv_size = ctx->receiving_length_data;
+}
+
+static receiving_state_type receiving_at_response_open (xbee_radio_type * ctx) {
+    return receiving_at_open (ctx);
+}
+
+static void receiving_at_response_done (xbee_radio_type * ctx) {
+    if (ctx->receiving_pending >= 0) {
+        receiving_truncated (ctx);
+        ctx->pending [ctx->receiving_pending].req->args.at.status = ctx->receiving_packet.at_response.status;
+        pending_complete (ctx, ctx->receiving_pending);
+    } else
+        ctx->stats.drop_unexpected ++;
+}
+#endif
+
+#if XBEE_FRAME_REMOTE_AT_RESPONSE
+static void receiving_remote_at_response_header (xbee_radio_type * ctx) {
+    volatile xbee_request_type * req;
+
+    req = receiving_at_request (ctx, xbee_request_remote_at, xbee_request_remote_at);
+    if (req == NULL)
+        return;
+    if (ctx->receiving_length_data > req->args.remote_at.buf_size)
+        ctx->receiving_length_data = req->args.remote_at.buf_size;
+    ctx->receiving_ptr_data = (unsigned char *) req->args.remote_at.buf_ptr;
+    req->args.remote_at.recv_size = ctx->receiving_length_data;
+}
+
+static receiving_state_type receiving_remote_at_response_open (xbee_radio_type * ctx) {
+    return receiving_at_open (ctx);
+}
+
+static void receiving_remote_at_response_done (xbee_radio_type * ctx) {
+    if (ctx->receiving_pending >= 0) {
+        receiving_truncated (ctx);
+#if XBEE_ADDR_CACHE_SIZE > 0
+        if (ctx->receiving_packet.remote_at_response.status == 0)
+            cache_learn (ctx, 
+              ctx->pending [ctx->receiving_pending].req->args.remote_at.addr_hi,
+              ctx->pending [ctx->receiving_pending].req->args.remote_at.addr_lo,
+              make_ushort (
+                ctx->receiving_packet.remote_at_response.addr16 [0], ctx->receiving_packet.remote_at_response.addr16 [1]
+              )
+            );
+#endif
+        ctx->pending [ctx->receiving_pending].req->args.remote_at.status = ctx->receiving_packet.remote_at_response.status;
+        pending_complete (ctx, ctx->receiving_pending);
+    } else
+        ctx->stats.drop_unexpected ++;
+}
+#endif
+
+#if XBEE_FRAME_RECEIVE
+static receiving_state_type receiving_receive_open (xbee_radio_type * ctx) {
+    ctx->receiving_length_data = ctx->receiving_packet_size - sizeof ctx->receiving_packet.receive;
+    if (ctx->expected_data && ctx->receiving_count == 0 && !ctx->divert) {
+        /* Somebody is waiting and nothing is queued: receive directly */
+        if (ctx->receiving_length_data > ctx->receive->buf_size)
+            ctx->receiving_length_data = ctx->receive->buf_size;
+        ctx->receiving_ptr_data = (unsigned char *) ctx->receive->buf_ptr;
+        ctx->receive->recv_size = ctx->receiving_length_data;
+        return receiving_state_data_requested;
+    }
+    if (ctx->receiving_used != (1 << XBEE_RECEIVING_SLOTS) - 1) {
+        /* The slot is marked as used only when the frame is complete */
+        for (ctx->receiving_slot = 0; ctx->receiving_used & (1 << ctx->receiving_slot); ctx->receiving_slot ++)
+            ;
+        if (ctx->receiving_length_data > sizeof ctx->receiving_slots [0].data)
+            ctx->receiving_length_data = sizeof ctx->receiving_slots [0].data;
+        ctx->receiving_ptr_data = ctx->receiving_slots [ctx->receiving_slot].data;
+        ctx->receiving_slots [ctx->receiving_slot].size = ctx->receiving_length_data;
+        return receiving_state_data;
+    }
+    /* The pool is exhausted */
+    ctx->stats.drop_no_slot ++;
+    ctx->receiving_length_data = 0;
+    return receiving_state_data_dropped;
+}
+
+static void receiving_receive_done (xbee_radio_type * ctx) {
+    xbee_frame_type * slot;
+
+    switch (ctx->receiving_state) {
+      case receiving_state_data_requested:
+        ctx->receive->addr_hi = make_ulong (
+          ctx->receiving_packet.receive.addr64 [0], ctx->receiving_packet.receive.addr64 [1], 
+          ctx->receiving_packet.receive.addr64 [2], ctx->receiving_packet.receive.addr64 [3]);
+        ctx->receive->addr_lo = make_ulong (
+          ctx->receiving_packet.receive.addr64 [4], ctx->receiving_packet.receive.addr64 [5], 
+          ctx->receiving_packet.receive.addr64 [6], ctx->receiving_packet.receive.addr64 [7]
+        );
+        ctx->receive->addr = make_ushort (
+          ctx->receiving_packet.receive.addr16 [0], ctx->receiving_packet.receive.addr16 [1]
+        );
+        ctx->receive_ok = 1;
+        ctx->expected_data = 0;
+        receiving_truncated (ctx);
+#if XBEE_ADDR_CACHE_SIZE > 0
+        cache_learn (ctx, ctx->receive->addr_hi, ctx->receive->addr_lo, ctx->receive->addr);
+#endif
+        break;
+      case receiving_state_data:
+        slot = &ctx->receiving_slots [ctx->receiving_slot];
+        slot->addr_hi = make_ulong (
+          ctx->receiving_packet.receive.addr64 [0], ctx->receiving_packet.receive.addr64 [1], 
+          ctx->receiving_packet.receive.addr64 [2], ctx->receiving_packet.receive.addr64 [3]);
+        slot->addr_lo = make_ulong (
+          ctx->receiving_packet.receive.addr64 [4], ctx->receiving_packet.receive.addr64 [5], 
+          ctx->receiving_packet.receive.addr64 [6], ctx->receiving_packet.receive.addr64 [7]
+        );
+        slot->addr = make_ushort (
+          ctx->receiving_packet.receive.addr16 [0], ctx->receiving_packet.receive.addr16 [1]
+        );
+        receiving_truncated (ctx);
+#if XBEE_ADDR_CACHE_SIZE > 0
+        cache_learn (ctx, slot->addr_hi, slot->addr_lo, slot->addr);
+#endif
+        ctx->receiving_used |= 1 << ctx->receiving_slot;
+        if (
+          ctx->divert && slot->size != 0 &&
+          slot->data [0] >= ctx->divert_first && slot->data [0] <= ctx->divert_last
+        ) {
+            ctx->receiving_diverted [ctx->receiving_diverted_count ++] = ctx->receiving_slot;
+            break;
+        }
+        ctx->receiving_ready [(ctx->receiving_head + ctx->receiving_count) % XBEE_RECEIVING_SLOTS] = ctx->receiving_slot;
+        ctx->receiving_count ++;
+        break;
+      default:
+        break;
+    }
+}
+#endif
+
+#define receiving_frame_entry(type, name, header) {   \
+      type, sizeof ((xbee_packet_type *) 0)->name,    \
+      receiving_##name##_open, header,                \
+      receiving_##name##_done                         \
+    },
+
+static const receiving_frame_type receiving_frames [] = {
+    XBEE_FRAMES (receiving_frame_entry)
+};
+
+#define receiving_frames_end (receiving_frames + sizeof receiving_frames / sizeof receiving_frames [0])
 
 /*
  * Receiver' state machine:
  *   receiving_state: xxx, got MARK -> length_1 -> length_2 -> frame_type ->
- *     modem_status | transmit_status | at_response | data_requested | state_data -> frame_mark
+ *     frame | at_response | data_requested | data | data_dropped -> frame_mark
+ *   The frame type selects the entry of receiving_frames, which handles the rest.
  *   receiving_bytes != 0 - meta state for processing the header, data and checksum.
+ *   Runs in interrupt, or in xbee_receiver task if UART_RX_RING_SIZE is defined.
  */
-void uart_receive_byte (unsigned char byte) {
+void uart_receive_byte (int port, unsigned char byte) {
+    xbee_radio_type * ctx = &radios [port];
+    const receiving_frame_type * frame;
+
+    ctx->stats.rx_bytes ++;
+
     /* Drop XON/XOFF */
     if (byte == 0x11 || byte == 0x13)
         return;
 
     if (byte == 0x7E) {
-        receiving_state = receiving_state_length_1;
-        receiving_esc = 0;
-        receiving_bytes = 0;
+        if (ctx->receiving_state != receiving_state_frame_mark)
+            ctx->stats.drop_partial ++;
+        ctx->receiving_state = receiving_state_length_1;
+        ctx->receiving_esc = 0;
+        ctx->receiving_bytes = 0;
         return;
     }
 
     if (byte == 0x7D) {
-        receiving_esc = 1;
+        ctx->receiving_esc = 1;
+        ctx->stats.rx_escapes ++;
         return;
     }
 	
-    if (receiving_esc) {
+    if (ctx->receiving_esc) {
         byte ^= 0x20;
-        receiving_esc = 0;
+        ctx->receiving_esc = 0;
     }
 	
-    if (receiving_bytes) {
-        if (receiving_length_read < receiving_length_header) {
-            receiving_chk += byte;
-            ((unsigned char *) &receiving_packet) [receiving_length_read] = byte;
-            receiving_length_read ++;
+    if (ctx->receiving_bytes) {
+        if (ctx->receiving_length_read < ctx->receiving_length_header) {
+            ctx->receiving_chk += byte;
+            ((unsigned char *) &ctx->receiving_packet) [ctx->receiving_length_read] = byte;
+            ctx->receiving_length_read ++;
+            if (
+              ctx->receiving_length_read == ctx->receiving_length_header &&
+              ctx->receiving_frame->header != NULL
+            )
+                ctx->receiving_frame->header (ctx);
             return;
         }
-        if (receiving_length_read < receiving_length_header + receiving_length_data) {
-            receiving_chk += byte;
-            receiving_ptr_data [receiving_length_read - receiving_length_header] = byte;
-            receiving_length_read ++;
+        if (ctx->receiving_length_read < ctx->receiving_length_header + ctx->receiving_length_data) {
+            ctx->receiving_chk += byte;
+            ctx->receiving_ptr_data [ctx->receiving_length_read - ctx->receiving_length_header] = byte;
+            ctx->receiving_length_read ++;
             return;
         }
-        if (receiving_length_read < receiving_packet_size) {
-            receiving_chk += byte;
-            receiving_length_read ++;
+        if (ctx->receiving_length_read < ctx->receiving_packet_size) {
+            ctx->receiving_chk += byte;
+            ctx->receiving_length_read ++;
             return;
         }
-        if (byte != (unsigned char) 0xff - receiving_chk) {
-            receiving_state = receiving_state_frame_mark;
+        if (byte != (unsigned char) 0xff - ctx->receiving_chk) {
+            ctx->stats.drop_checksum ++;
+            ctx->receiving_state = receiving_state_frame_mark;
             return;
         }
-        receiving_bytes = 0;
+        ctx->receiving_bytes = 0;
+        ctx->stats.rx_frames ++;
     }
 	
-    switch (receiving_state) {
+    switch (ctx->receiving_state) {
+      case receiving_state_frame_mark:
+        return;
       case receiving_state_length_1:
-        receiving_packet_size = (unsigned) byte << 8;
-        receiving_state = receiving_state_length_2;
+        ctx->receiving_packet_size = (unsigned) byte << 8;
+        ctx->receiving_state = receiving_state_length_2;
         return;
       case receiving_state_length_2:
-        receiving_packet_size |= byte;
-        if (receiving_packet_size == 0) {
-            receiving_state = receiving_state_frame_mark; /* Wrong frame */
+        ctx->receiving_packet_size |= byte;
+        if (ctx->receiving_packet_size == 0) {
+            ctx->stats.drop_length ++;
+            ctx->receiving_state = receiving_state_frame_mark; /* Wrong frame */
             return;
         }
-        receiving_packet_size --; /* 1 byte is used for frame type */
-        receiving_state = receiving_state_frame_type;
+        ctx->receiving_packet_size --; /* 1 byte is used for frame type */
+        ctx->receiving_state = receiving_state_frame_type;
         return;
       case receiving_state_frame_type:
-        switch (byte) {
-          case 0x8A: /* Modem status packet */
-            if (receiving_packet_size < sizeof receiving_packet.status) {
-                receiving_state = receiving_state_frame_mark;
-                return;
-            }
-            receiving_length_header = sizeof receiving_packet.status;
-            receiving_length_data = 0;
-            receiving_state = receiving_state_modem_status;
-            break;
-          case 0x8B: /* Transmit status packed */
-            if (
-              receiving_packet_size < sizeof receiving_packet.transmit_status ||
-              expected_response != expected_transmit_status
-            ) {
-                receiving_state = receiving_state_frame_mark;
-                return;
-            }
-            receiving_length_header = sizeof receiving_packet.transmit_status;
-            receiving_length_data = 0;
-            receiving_state = receiving_state_transmit_status;
-            break;
-          case 0x88: /* AT command response packet */
-            if (
-              receiving_packet_size < sizeof receiving_packet.at_response ||
-              expected_response != expected_at_response
-            ) {
-                receiving_state = receiving_state_frame_mark;
-                return;
-            }
-            receiving_length_header = sizeof receiving_packet.at_response;
-            receiving_length_data = receiving_packet_size - sizeof receiving_packet.at_response;
-            if (receiving_length_data > request->args.at.buf_size)
-                receiving_length_data = request->args.at.buf_size;
-            receiving_ptr_data = (unsigned char *) request->args.at.buf_ptr;
-            request->args.at.recv_size = receiving_length_data;
-            receiving_state = receiving_state_at_response;
-            break;
-          case 0x90: /* Receive packet */
-            if (receiving_packet_size < sizeof receiving_packet.receive) {
-                receiving_state = receiving_state_frame_mark;
-                return;
-            }
-            receiving_length_header = sizeof receiving_packet.receive;
-            receiving_length_data = receiving_packet_size - sizeof receiving_packet.receive;
-            if (!expected_data) {
-                if (receiving_length_data > sizeof receiving_buffer)
-                    receiving_length_data = sizeof receiving_buffer;
-                receiving_ptr_data = receiving_buffer;
-                receiving_state = receiving_state_data;
-            } else {
-                receive->addr = make_ushort (
-                  receiving_packet.receive.addr16 [0], receiving_packet.receive.addr16 [1]
-                );
-                if (receiving_length_data > receive->buf_size)
-                    receiving_length_data = receive->buf_size;
-                receiving_ptr_data = (unsigned char *) receive->buf_ptr;
-                receiving_state = receiving_state_data_requested;
-                receive->recv_size = receiving_length_data;
-            }
-            break;
-          default:
-            receiving_state = receiving_state_frame_mark;
+        for (frame = receiving_frames; frame < receiving_frames_end && frame->type != byte; frame ++)
+            ;
+        if (frame == receiving_frames_end) {
+            ctx->stats.drop_type ++;
+            ctx->receiving_state = receiving_state_frame_mark;
             return;
         }
-        receiving_length_read = 0;
-        receiving_chk = byte;
-        receiving_bytes = 1;
-        return;
-      case receiving_state_modem_status:
-        switch (receiving_packet.status.status) {
-          case 0x02:
-            associated = 1;
-            break;
-          case 0x03:
-            associated = 0;
-            if (expected_data)
-                expected_data = 0;
-            break;
+        if (ctx->receiving_packet_size < frame->header_size) {
+            ctx->stats.drop_length ++;
+            ctx->receiving_state = receiving_state_frame_mark;
+            return;
         }
-        receiving_state = receiving_state_frame_mark;
+        ctx->receiving_frame = frame;
+        ctx->receiving_length_header = frame->header_size;
+        ctx->receiving_length_data = 0;
+        ctx->receiving_state = frame->open (ctx);
+        if (ctx->receiving_state == receiving_state_frame_mark)
+            return;
+        ctx->receiving_length_read = 0;
+        ctx->receiving_chk = byte;
+        ctx->receiving_bytes = 1;
         return;
-      case receiving_state_transmit_status:
-        request->args.transmit.status = receiving_packet.transmit_status.delivery;
-        expected_response = expected_nothing;
-        receiving_state = receiving_state_frame_mark;
+      default:
+        ctx->receiving_frame->done (ctx);
+        ctx->receiving_state = receiving_state_frame_mark;
         return;
-      case receiving_state_at_response:
-        if (receiving_packet.at_request.id == transmitting_sequence) {
-            request->args.at.status = receiving_packet.at_response.status;
-            expected_response = expected_nothing;
+    }
+}
+
+/* Takes the oldest frame off the queue. The frame stays in use. */
+static xbee_frame_type * receiving_dequeue (xbee_radio_type * ctx) {
+    xbee_frame_type * frame;
+    int mask;
+
+    mask = get_mask ();
+    frame = &ctx->receiving_slots [ctx->receiving_ready [ctx->receiving_head]];
+    ctx->receiving_head = (ctx->receiving_head + 1) % XBEE_RECEIVING_SLOTS;
+    ctx->receiving_count --;
+    set_mask (mask);
+    return frame;
+}
+
+/**
+ * @brief  Return a frame obtained by @ref xbee_receive_frame to the pool
+ * @param  frame  the frame
+ */
+void xbee_release_frame (xbee_frame_type * frame) {
+    xbee_radio_type * ctx = &radios [frame->radio];
+    int mask;
+
+    mask = get_mask ();
+    ctx->receiving_used &= ~(1 << (frame - ctx->receiving_slots));
+    set_mask (mask);
+}
+
+/**
+ * @brief  Keep frames of another layer apart from the application's
+ *
+ * Frames whose first data byte is from @a first to @a last no longer
+ * go to @ref xbee_receive and @ref xbee_receive_frame; they are taken
+ * with @ref xbee_take. While frames are diverted, none are received
+ * directly into the caller's buffer of @ref xbee_receive. The range
+ * replaces the previous one; with @a first above @a last nothing is
+ * diverted. Frames diverted before stay until they are taken.
+ *
+ * @param  radio  the radio
+ * @param  first  lowest first byte
+ * @param  last  highest first byte
+ */
+void xbee_divert (int radio, unsigned char first, unsigned char last) {
+    xbee_radio_type * ctx = &radios [radio];
+    int mask;
+
+    mask = get_mask ();
+    ctx->divert_first = first;
+    ctx->divert_last = last;
+    ctx->divert = first <= last;
+    set_mask (mask);
+}
+
+/**
+ * @brief  Tells whether a diverted frame whose first byte is in a range is waiting
+ *
+ * Takes nothing, so it can be used in a wait condition before
+ * @ref xbee_take.
+ *
+ * @param  radio  the radio
+ * @param  first  lowest first byte
+ * @param  last  highest first byte
+ * @return  nonzero if there is such a frame
+ */
+int xbee_diverted (int radio, unsigned char first, unsigned char last) {
+    xbee_radio_type * ctx = &radios [radio];
+    unsigned char c;
+    int i;
+
+    for (i = 0; i < ctx->receiving_diverted_count; i ++) {
+        c = ctx->receiving_slots [ctx->receiving_diverted [i]].data [0];
+        if (c >= first && c <= last)
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief  Take the oldest diverted frame whose first byte is in a range
+ *
+ * This is not a task: it does not wait. The frame is lent as by
+ * @ref xbee_receive_frame and has to be given back with
+ * @ref xbee_release_frame.
+ *
+ * @param  radio  the radio
+ * @param  first  lowest first byte
+ * @param  last  highest first byte
+ * @param  frame_ptr  receives the pointer to the frame
+ * @return  nonzero if a frame was taken, 0 if there is none
+ */
+int xbee_take (int radio, unsigned char first, unsigned char last, xbee_frame_type ** frame_ptr) {
+    xbee_radio_type * ctx = &radios [radio];
+    xbee_frame_type * frame;
+    int i, mask;
+
+    mask = get_mask ();
+    for (i = 0; i < ctx->receiving_diverted_count; i ++) {
+        frame = &ctx->receiving_slots [ctx->receiving_diverted [i]];
+        if (frame->data [0] >= first && frame->data [0] <= last) {
+            ctx->receiving_diverted_count --;
+            for (; i < ctx->receiving_diverted_count; i ++)
+                ctx->receiving_diverted [i] = ctx->receiving_diverted [i + 1];
+            set_mask (mask);
+            *frame_ptr = frame;
+            return 1;
         }
-        receiving_state = receiving_state_frame_mark;
-        return;
-      case receiving_state_data_requested:
-        receive->addr_hi = make_ulong (
-          receiving_packet.receive.addr64 [0], receiving_packet.receive.addr64 [1], 
-          receiving_packet.receive.addr64 [2], receiving_packet.receive.addr64 [3]);
-        receive->addr_lo = make_ulong (
-          receiving_packet.receive.addr64 [4], receiving_packet.receive.addr64 [5], 
-          receiving_packet.receive.addr64 [6], receiving_packet.receive.addr64 [7]
-        );
-        receive_ok = 1;
-        expected_data = 0;
-        /* Fall through */
-      case receiving_state_data:
-        receiving_state = receiving_state_frame_mark;
-        return;
     }
+    set_mask (mask);
+    return 0;
 }
 
 /**
- * @brief  Performe XBee receive operation
- * @param  recv_ptr  structure contatining input and output data
- *                  ( see @ref xbee_receive_type)
+ * @brief  Get a snapshot of the driver statistics
+ * @param  radio  the radio
+ * @param  st  receives the counters (see @ref xbee_stats_type)
  */
-int xbee_receive (struct xbee_receive * recv_ptr) {
+void xbee_get_stats (int radio, xbee_stats_type * st) {
+    xbee_radio_type * ctx = &radios [radio];
+    int mask;
+
+    mask = get_mask ();
+    memcpy (st, (void *) &ctx->stats, sizeof ctx->stats);
+#ifdef UART_RX_RING_SIZE
+    st->uart_overruns = uart_rx_overruns [ctx->port];
+    st->uart_frame_errors = uart_rx_frame_errors [ctx->port];
+    st->uart_dropped = uart_rx_dropped [ctx->port];
+#endif
+    set_mask (mask);
+}
+
+/**
+ * @brief  Clear the driver statistics
+ * @param  radio  the radio
+ */
+void xbee_reset_stats (int radio) {
+    xbee_radio_type * ctx = &radios [radio];
+    int mask;
+
+    mask = get_mask ();
+    memset ((void *) &ctx->stats, 0, sizeof ctx->stats);
+#ifdef UART_RX_RING_SIZE
+    uart_rx_overruns [ctx->port] = 0;
+    uart_rx_frame_errors [ctx->port] = 0;
+    uart_rx_dropped [ctx->port] = 0;
+#endif
+    set_mask (mask);
+}
+
+#ifdef UART_RX_RING_SIZE
+/* Some port of a radio has received bytes */
+static int receiver_ready (void) {
+    int n;
+
+    for (n = 0; n < XBEE_RADIOS; n ++)
+        if (uart_rx_count (n) != 0)
+            return 1;
+    return 0;
+}
+
+/**
+ * @brief  Decodes the bytes collected by the UART receive interrupts
+ *
+ * This is a loop task. It has to be added to the project file
+ * when UART_RX_RING_SIZE is defined. It serves all the radios.
+ */
+void xbee_receiver (void) {
+    int n, byte;
+
+    SynthOS_wait (receiver_ready ());
+
+    for (n = 0; n < XBEE_RADIOS; n ++)
+        while ((byte = uart_rx_get (n)) != -1)
+            uart_receive_byte (n, (unsigned char) byte);
+}
+#endif
+
+/* Moves the oldest queued frame to the caller's buffer */
+static void receive_copy (xbee_radio_type * ctx, struct xbee_receive * recv_ptr) {
+    xbee_frame_type * frame;
+
+    frame = receiving_dequeue (ctx);
+    recv_ptr->addr_hi = frame->addr_hi;
+    recv_ptr->addr_lo = frame->addr_lo;
+    recv_ptr->addr = frame->addr;
+    recv_ptr->recv_size = frame->size;
+    if (recv_ptr->recv_size > recv_ptr->buf_size)
+        recv_ptr->recv_size = recv_ptr->buf_size;
+    memcpy (recv_ptr->buf_ptr, frame->data, recv_ptr->recv_size);
+    xbee_release_frame (frame);
+}
+
+/*
+ * First half of the receive operation.
+ * Returns 1 if a queued frame was taken, 0 if the module is not associated,
+ * -1 if the caller has to wait for receive_finish.
+ */
+static int receive_start (xbee_radio_type * ctx, struct xbee_receive * recv_ptr) {
     int mask;
-    uint16_t have;
 
-    /* Avoiding the race condition: check - interrupt resets "associated" - infinite wait */
     mask = get_mask ();
 
-    if (!associated) {
+    if (ctx->receiving_count != 0) {
+        set_mask (mask);
+        receive_copy (ctx, recv_ptr);
+        return 1;
+    }
+
+    /* Avoiding the race condition: check - interrupt resets "associated" - infinite wait */
+    if (!(associated & (1 << ctx->port))) {
         set_mask (mask);
         return 0;
     }
 
-    receive = recv_ptr;
-
-    receive_ok = 0;
-
-    have = 0;
-
-    if (receiving_state == receiving_state_data) {
-        /* We are already in process of receiving a data packet */
-        if (receiving_length_read <= sizeof receiving_packet.receive) {
-            /* We are receiving the header */
-            receiving_length_data = receiving_packet_size - sizeof receiving_packet.receive;
-            if (receiving_length_data > receive->buf_size)
-                receiving_length_data = receive->buf_size;
-            receiving_ptr_data = receive->buf_ptr;
-            receive->recv_size = receiving_length_data;
-            receiving_state = receiving_state_data_requested;
-        } else if (receiving_length_read <= sizeof receiving_packet.receive + receiving_length_data) {
-            /* We are receiving the data. No buffer overflow yet. */
-            have = receiving_length_read - sizeof receiving_packet.receive;
-            if (have >= receive->buf_size) {
-                have = receive->buf_size;
-                receive->recv_size = have;
-                receiving_length_data = 0; /* No more data is needed */
-            } else {
-                receiving_length_data = receiving_packet_size - sizeof receiving_packet.receive;
-                if (receiving_length_data > receive->buf_size)
-                    receiving_length_data = receive->buf_size;
-                receive->recv_size = receiving_length_data;
-                receiving_ptr_data = (unsigned char *) receive->buf_ptr + have;
-            }
-            receiving_state = receiving_state_data_requested;
-        } else {
-            /* We are receiving the data. Buffer overflow already happened. */
-            have = receiving_length_data;
-            if (have > receive->buf_size)
-                have = receive->buf_size;
-            receive->recv_size = have;
-            receiving_state = receiving_state_data_requested;
-        }
+    ctx->receive = recv_ptr;
+    ctx->receive_ok = 0;
+    ctx->expected_data = 1;
+
+    set_mask (mask);
+    return -1;
+}
+
+/*
+ * Second half of the receive operation.
+ * A frame that was already coming in when receive_start was called
+ * goes to the queue rather than to the caller's buffer.
+ * If nothing came, the time is out.
+ */
+static int receive_finish (xbee_radio_type * ctx, struct xbee_receive * recv_ptr) {
+    int mask;
+
+    mask = get_mask ();
+
+    if (!ctx->expected_data) {
+        set_mask (mask);
+        return ctx->receive_ok;
+    }
+
+    ctx->expected_data = 0;
+
+    if (ctx->receiving_count != 0) {
+        set_mask (mask);
+        receive_copy (ctx, recv_ptr);
+        return 1;
     }
 
-    expected_data = 1;
+    if (ctx->receiving_state == receiving_state_data_requested) {
+        /* Do not touch the caller's buffer any more */
+        ctx->receiving_length_data = 0;
+        ctx->receiving_state = receiving_state_data_dropped;
+    }
 
     set_mask (mask);
+    return xbee_timeout;
+}
+
+/**
+ * @brief  Performe XBee receive operation
+ *
+ * Frames that arrived while no receive operation was pending are
+ * taken from the queue first, in the order they were received.
+ * If another task takes the frame first (e.g. with
+ * @ref xbee_receive_frame), the operation waits for the next one.
+ *
+ * @param  recv_ptr  structure contatining input and output data
+ *                  ( see @ref xbee_receive_type)
+ * @return  nonzero on success, 0 if the module is not associated
+ */
+int xbee_receive (struct xbee_receive * recv_ptr) {
+    xbee_radio_type * ctx;
+    int r;
+
+    ctx = &radios [recv_ptr->radio];
+
+    do {
+        r = receive_start (ctx, recv_ptr);
+        if (r != -1)
+            return r;
+
+        SynthOS_wait (!ctx->expected_data || ctx->receiving_count != 0);
 
-    if (have)
-        /* Copy data after restoring interrupts mask */
-        memcpy (receive->buf_ptr, receiving_buffer, have);
+        /* xbee_timeout: another task took the frame that woke us up */
+        r = receive_finish (ctx, recv_ptr);
+    } while (r == xbee_timeout);
 
-    SynthOS_wait (!expected_data);
+    return r;
+}
+
+/**
+ * @brief  Performe XBee receive operation with a time limit
+ * @param  recv_ptr  structure contatining input and output data
+ *                  ( see @ref xbee_receive_type)
+ * @param  ticks  time limit in clock ticks (~10ms each)
+ * @return  nonzero on success, 0 if the module is not associated,
+ *          @a xbee_timeout if the time is out
+ */
+int xbee_receive_timed (struct xbee_receive * recv_ptr, unsigned ticks) {
+    xbee_radio_type * ctx;
+    timer_type timeout;
+    int r;
+
+    ctx = &radios [recv_ptr->radio];
+
+    timer_arm (&timeout, ticks);
+    do {
+        r = receive_start (ctx, recv_ptr);
+        if (r != -1)
+            break;
+
+        SynthOS_wait (!ctx->expected_data || ctx->receiving_count != 0 || timeout.fired);
+
+        /* xbee_timeout before the time is out: another task took the frame */
+        r = receive_finish (ctx, recv_ptr);
+    } while (r == xbee_timeout && !timeout.fired);
+    timer_cancel (&timeout);
+
+    return r;
+}
+
+/* A radio with queued frames, starting from receiving_next, or NULL */
+static xbee_radio_type * receiving_queued (void) {
+    int i, n;
+
+    for (i = 0; i < XBEE_RADIOS; i ++) {
+        n = (receiving_next + i) % XBEE_RADIOS;
+        if (radios [n].receiving_count != 0)
+            return &radios [n];
+    }
+    return NULL;
+}
+
+/**
+ * @brief  Performe XBee receive operation without copying the data
+ *
+ * The frame is received directly into a buffer of the driver's pool
+ * and is lent to the caller. The caller must give it back with
+ * @ref xbee_release_frame as soon as it is done with it: while it holds
+ * the frame, the driver has one slot less for incoming data.
+ *
+ * Frames of all the radios are served, in turn; the frame tells
+ * which radio it came from.
+ *
+ * @param  frame_ptr  receives the pointer to the frame
+ *                    (see @ref xbee_frame_type)
+ * @return  nonzero on success, 0 if no radio is associated
+ */
+int xbee_receive_frame (xbee_frame_type ** frame_ptr) {
+    xbee_radio_type * ctx;
+
+    SynthOS_wait (receiving_queued () != NULL || !associated);
+
+    ctx = receiving_queued ();
+    if (ctx == NULL)
+        return 0;
 
-    return receive_ok;
+    *frame_ptr = receiving_dequeue (ctx);
+    receiving_next = (ctx->port + 1) % XBEE_RADIOS;
+    return 1;
 }
@@ -24,24 +24,62 @@
 #define XBEE_RECEIVING_BUFFER_SIZE 64
 #endif
 
+#ifndef XBEE_RECEIVING_SLOTS
+#define XBEE_RECEIVING_SLOTS 4
+#endif
+
+#ifndef XBEE_ADDR_CACHE_SIZE
+#define XBEE_ADDR_CACHE_SIZE 4
+#endif
+
+/* Largest RF payload (NP), used until the radio reports its own */
+#ifndef XBEE_MAX_PAYLOAD
+#define XBEE_MAX_PAYLOAD 84
+#endif
+
+#ifndef XBEE_MAX_PENDING
+#define XBEE_MAX_PENDING 4
+#endif
+
+/* Number of radios, radio n is attached to UART port n (see UART_PORTS) */
+#ifndef XBEE_RADIOS
+#define XBEE_RADIOS 1
+#endif
+
 #define xbee_addr_unknown 0xFFFE
 
+/** @brief Return value of the timed operations when the time is out */
+#define xbee_timeout (-1)
+
+/** @brief Return value of @c xbee_request_timed for a request type that is not compiled in */
+#define xbee_refused (-2)
+
+/** @brief Request status set by the timed operations when the time is out */
+#define xbee_status_timeout 0xFF
+
 /**
  * @brief XBee request types
  *
  * @param  xbee_request_at  execute an AT command
  * @param  xbee_request_transmit  transmit a packet
+ * @param  xbee_request_at_queue  queue an AT parameter value, applied by
+ *                                a later AC (or any @c xbee_request_at)
+ * @param  xbee_request_remote_at  execute an AT command on a remote module
  */
 typedef enum {
     xbee_request_at,
-    xbee_request_transmit
+    xbee_request_transmit,
+    xbee_request_at_queue,
+    xbee_request_remote_at
 } xbee_request_selector_type;
 
 /**
  * @brief  Structure containing input and output parameters for XBee requests
  * @param  [in] req  request type (see @ref xbee_request_selector_type)
+ * @param  [out] busy  nonzero while the request is in flight (see @ref xbee_post)
+ * @param  [in] radio  radio to use, 0 to XBEE_RADIOS - 1
  * @param  [in,out] args  request parameters
- * @param  [in,out] args.at  parameters for @c xbee_request_at
+ * @param  [in,out] args.at  parameters for @c xbee_request_at and @c xbee_request_at_queue
  * @param  [in] args.at.cmd  AT command
  * @param  [in] args.at.data_ptr  input data pointer 
  * @param  [in] args.at.data_size  input data size
@@ -56,9 +94,26 @@ typedef enum {
  * @param  [in] args.transmit.data_ptr  input data pointer 
  * @param  [in] args.transmit.data_size  input data size
  * @param  [out] args.at.status  reported delivery status
+ * @param  [out] args.transmit.id  frame ID the request was sent with
+ * @param  [out] args.transmit.retries  transmit retries reported with the status
+ * @param  [out] args.transmit.discovery  discovery status reported with the status
+ * @param  [in,out] args.remote_at parameters for @c xbee_request_remote_at
+ * @param  [in] args.remote_at.addr_hi  highest 32 bits of the 64 bit network address of the remote module (SH)
+ * @param  [in] args.remote_at.addr_lo  lowest 32 bits of the 64 bit network address of the remote module (SL)
+ * @param  [in] args.remote_at.addr  16 bit address of the remote module (use @a xbee_addr_unknown, if do not know)
+ * @param  [in] args.remote_at.options  remote command options (0x02 - apply changes)
+ * @param  [in] args.remote_at.cmd  AT command
+ * @param  [in] args.remote_at.data_ptr  input data pointer 
+ * @param  [in] args.remote_at.data_size  input data size
+ * @param  [in] args.remote_at.buf_ptr  output buffer pointer 
+ * @param  [in] args.remote_at.buf_size  output buffer size
+ * @param  [out] args.remote_at.recv_size  received data size
+ * @param  [out] args.remote_at.status  reported status (4 - no response from the remote module)
  */
 typedef struct xbee_request {
     xbee_request_selector_type req;
+    volatile unsigned char busy;
+    unsigned char radio;
     union {
         struct {
             char cmd [2];
@@ -76,7 +131,23 @@ typedef struct xbee_request {
             void * data_ptr;
             uint16_t data_size;
             unsigned char status;
+            unsigned char id;
+            unsigned char retries;
+            unsigned char discovery;
         } transmit;
+        struct {
+            uint32_t addr_hi;
+            uint32_t addr_lo;
+            uint16_t addr;
+            unsigned char options;
+            char cmd [2];
+            void * data_ptr;
+            uint16_t data_size;
+            void * buf_ptr;
+            uint16_t buf_size;
+            uint16_t recv_size;
+            unsigned char status;
+        } remote_at;
     } args;
 } xbee_request_type;
 
@@ -88,6 +159,7 @@ typedef struct xbee_request {
  * @param  [in] buf_ptr  output buffer pointer 
  * @param  [in] buf_size  output buffer size
  * @param  [out] recv_size  received data size
+ * @param  [in] radio  radio to receive from, 0 to XBEE_RADIOS - 1
  */
 typedef struct xbee_receive {
     uint32_t addr_hi;
@@ -96,14 +168,135 @@ typedef struct xbee_receive {
     void * buf_ptr;
     uint16_t buf_size;
     uint16_t recv_size;
+    unsigned char radio;
 } xbee_receive_type;
 
+/**
+ * @brief  Received frame lent to the application by @ref xbee_receive_frame
+ * @param  addr_hi  highest 32 bits of the 64 bit network address of the sender (SH)
+ * @param  addr_lo  lowest 32 bits of the 64 bit network address of the sender (SL)
+ * @param  addr  16 bit address of the sender
+ * @param  size  received data size
+ * @param  radio  radio the frame came from
+ * @param  data  received data
+ */
+typedef struct xbee_frame {
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint16_t addr;
+    uint16_t size;
+    unsigned char radio;
+    unsigned char data [XBEE_RECEIVING_BUFFER_SIZE];
+} xbee_frame_type;
+
+void xbee_release_frame (xbee_frame_type * frame);
+void xbee_divert (int radio, unsigned char first, unsigned char last);
+int xbee_diverted (int radio, unsigned char first, unsigned char last);
+int xbee_take (int radio, unsigned char first, unsigned char last, xbee_frame_type ** frame_ptr);
+void xbee_cancel (xbee_request_type * req_ptr);
+
+/**
+ * @brief  Driver statistics (see @ref xbee_get_stats)
+ *
+ * Counters wrap around.
+ *
+ * @param  tx_bytes  bytes sent to UART
+ * @param  tx_frames  frames sent to UART
+ * @param  tx_escapes  escape characters sent
+ * @param  rx_bytes  bytes received from UART
+ * @param  rx_frames  frames received with correct checksum
+ * @param  rx_escapes  escape characters received
+ * @param  drop_partial  frames cut short by the next frame mark
+ * @param  drop_checksum  frames dropped on checksum mismatch
+ * @param  drop_length  frames dropped as too short for their type
+ * @param  drop_type  frames of unknown type
+ * @param  drop_unexpected  responses (0x8B, 0x88) that match no request in flight
+ * @param  drop_no_slot  data frames dropped because the receive pool was exhausted
+ * @param  truncated  frames with more data than the buffer could take
+ * @param  modem_reset  modem status: hardware or watchdog reset
+ * @param  modem_joined  modem status: joined network
+ * @param  modem_left  modem status: disassociated
+ * @param  modem_other  modem status: anything else
+ * @param  uart_overruns  UART data overruns (only with UART_RX_RING_SIZE)
+ * @param  uart_frame_errors  UART frame errors (only with UART_RX_RING_SIZE)
+ * @param  uart_dropped  bytes lost on full receive ring (only with UART_RX_RING_SIZE)
+ */
+typedef struct xbee_stats {
+    uint32_t tx_bytes;
+    uint16_t tx_frames;
+    uint16_t tx_escapes;
+    uint32_t rx_bytes;
+    uint16_t rx_frames;
+    uint16_t rx_escapes;
+    uint16_t drop_partial;
+    uint16_t drop_checksum;
+    uint16_t drop_length;
+    uint16_t drop_type;
+    uint16_t drop_unexpected;
+    uint16_t drop_no_slot;
+    uint16_t truncated;
+    uint16_t modem_reset;
+    uint16_t modem_joined;
+    uint16_t modem_left;
+    uint16_t modem_other;
+    uint16_t uart_overruns;
+    uint16_t uart_frame_errors;
+    uint16_t uart_dropped;
+} xbee_stats_type;
+
+void xbee_get_stats (int radio, xbee_stats_type * st);
+void xbee_reset_stats (int radio);
+
+#ifdef XBEE_LATENCY
+#ifndef XBEE_LATENCY_BUCKETS
+#define XBEE_LATENCY_BUCKETS 16
+#endif
+
+/**
+ * @brief  Latency histograms (see @ref xbee_get_latency)
+ *
+ * Time is measured with lclock in 64us units. Bucket n counts periods
+ * from 2^n to 2^(n+1)-1 units, the last bucket also counts everything longer.
+ * Counters stop at 0xFFFF.
+ *
+ * @param  uart  time from the frame start to the last byte of the frame
+ *               (to the last byte put to the ring if UART_TX_RING_SIZE is defined)
+ * @param  radio  time from the last byte of the frame to the response (0x8B, 0x88)
+ */
+typedef struct xbee_latency {
+    uint16_t uart [XBEE_LATENCY_BUCKETS];
+    uint16_t radio [XBEE_LATENCY_BUCKETS];
+} xbee_latency_type;
+
+void xbee_get_latency (int radio, xbee_latency_type * lat);
+void xbee_reset_latency (int radio);
+#endif
+
 /**
  * @brief Association indicator
  *
+ * Bit n is set while radio n is associated, so with a single radio:
+ *
  * --------------------------------------------------------
  * Value               | Meaning
  * --------------------|-----------------------------------
  * 0 - not associated  | !0 - associated
  */
 extern volatile int associated;
+
+/**
+ * @brief Largest RF payload of a transmit request (NP), the same for all radios
+ */
+extern uint16_t xbee_max_payload;
+
+int xbee_quiet (int radio);
+
+#ifdef XBEE_POWER
+/**
+ * @brief Sleep indicator (see xbee-power.h)
+ *
+ * Bit n is set while radio n is asleep: @ref xbee_post holds the
+ * requests for it until it wakes up.
+ */
+extern volatile int xbee_asleep;
+#endif